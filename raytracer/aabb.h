@@ -0,0 +1,169 @@
+//
+//  Framework for a raytracer
+//  File: aabb.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef AABB_H
+#define AABB_H
+
+#include <limits>
+#include "triple.h"
+#include "ray.h"
+#include "transform.h"
+
+/**
+ * Axis-aligned bounding box. A default-constructed box is empty
+ * (min > max), extending it with points or other boxes grows it.
+ */
+class AABB
+{
+public:
+	Point min, max;
+
+	AABB()
+		: min(std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()),
+		max(-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max())
+	{ }
+
+	AABB(const Point &min, const Point &max) : min(min), max(max) { }
+
+	/**
+	 * A box that contains everything. Used by objects that can't
+	 * (yet) tell how large they are.
+	 */
+	static AABB infinite()
+	{
+		double big = std::numeric_limits<double>::max();
+		return AABB(Point(-big, -big, -big), Point(big, big, big));
+	}
+
+	bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+	bool isInfinite() const
+	{
+		double big = std::numeric_limits<double>::max();
+		return min.x <= -big || min.y <= -big || min.z <= -big || max.x >= big || max.y >= big || max.z >= big;
+	}
+
+	void extend(const Point &p)
+	{
+		for (int i = 0; i < 3; i++) {
+			if (p.data[i] < min.data[i]) min.data[i] = p.data[i];
+			if (p.data[i] > max.data[i]) max.data[i] = p.data[i];
+		}
+	}
+
+	void extend(const AABB &b)
+	{
+		for (int i = 0; i < 3; i++) {
+			if (b.min.data[i] < min.data[i]) min.data[i] = b.min.data[i];
+			if (b.max.data[i] > max.data[i]) max.data[i] = b.max.data[i];
+		}
+	}
+
+	// Grow the box by d in every direction, so flat boxes (e.g. around
+	// an axis-aligned triangle) don't suffer from roundoff in intersect()
+	void pad(double d) { min -= d; max += d; }
+
+	Point center() const { return (min + max)/2; }
+	Vector extent() const { return max - min; }
+
+	double surfaceArea() const
+	{
+		if (isEmpty()) return 0.0;
+		Vector e = extent();
+		return 2*(e.x*e.y + e.y*e.z + e.z*e.x);
+	}
+
+	int largestAxis() const
+	{
+		Vector e = extent();
+		if (e.x >= e.y && e.x >= e.z) return 0;
+		return e.y >= e.z ? 1 : 2;
+	}
+
+	/**
+	 * Slab test.
+	 * @param ray Ray to intersect with
+	 * @param invD Componentwise inverse of ray.D, see inverseDirection()
+	 * @param maxT Ignore intersections with a t value greater than this
+	 * @param tNear If the box is hit, the t value where the ray enters it (0 if it starts inside) is written here
+	 * @return Whether the ray hits the box between 0 and maxT
+	 */
+	bool intersect(const Ray &ray, const Vector &invD, double maxT, double *tNear) const
+	{
+		double t0 = 0.0, t1 = maxT;
+		for (int i = 0; i < 3; i++) {
+			double tA = (min.data[i] - ray.O.data[i]) * invD.data[i];
+			double tB = (max.data[i] - ray.O.data[i]) * invD.data[i];
+			if (tA > tB) { double tmp = tA; tA = tB; tB = tmp; }
+			if (tA > t0) t0 = tA;
+			if (tB < t1) t1 = tB;
+			if (t0 > t1) return false;
+		}
+		*tNear = t0;
+		return true;
+	}
+
+	/**
+	 * Slab test against the whole line through the ray, in both
+	 * directions. Used to cull objects that are intersected over the whole
+	 * line, see Object::getSpans().
+	 * @param invD Componentwise inverse of ray.D, see inverseDirection()
+	 */
+	bool intersectsLine(const Ray &ray, const Vector &invD) const
+	{
+		double t0 = -std::numeric_limits<double>::max(), t1 = std::numeric_limits<double>::max();
+		for (int i = 0; i < 3; i++) {
+			double tA = (min.data[i] - ray.O.data[i]) * invD.data[i];
+			double tB = (max.data[i] - ray.O.data[i]) * invD.data[i];
+			if (tA > tB) { double tmp = tA; tA = tB; tB = tmp; }
+			if (tA > t0) t0 = tA;
+			if (tB < t1) t1 = tB;
+			if (t0 > t1) return false;
+		}
+		return true;
+	}
+
+	/**
+	 * The box around this box after transforming it, i.e. around its eight
+	 * corners. Empty and infinite boxes stay what they are.
+	 */
+	AABB transformed(const Transform &T) const
+	{
+		if (isEmpty() || isInfinite())
+			return *this;
+		AABB box;
+		for (int i = 0; i < 8; i++)
+			box.extend(T.apply(Point(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z)));
+		return box;
+	}
+
+	/**
+	 * Compute the componentwise inverse of a ray direction for intersect().
+	 * Zero components are replaced by a tiny value rather than producing
+	 * infinities, which -ffast-math doesn't promise to handle.
+	 */
+	static Vector inverseDirection(const Vector &D)
+	{
+		Vector inv;
+		for (int i = 0; i < 3; i++) {
+			double d = D.data[i];
+			if (fabs(d) < 1e-12) d = d < 0 ? -1e-12 : 1e-12;
+			inv.data[i] = 1.0/d;
+		}
+		return inv;
+	}
+};
+
+#endif /* end of include guard: AABB_H */
@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+# Compare render time and peak memory use of the raytracer with colors,
+# images and textures stored as float (the default) and as double.
+#
+# Usage: ./benchmark.sh [scene.yaml ...]
+# Without arguments all scenes in scenes/ are rendered. Both builds are
+# made in temporary copies of the sources, so the objects and the ray
+# executable in this directory are left alone.
+#
+
+if [ $# -eq 0 ]; then
+	set -- scenes/*.yaml
+fi
+
+OUT=`mktemp -d /tmp/benchmark.XXXXXX` || exit 1
+
+# Builds the raytracer in a copy of the sources and moves it to $OUT/$1
+build()
+{
+	name=$1
+	shift
+	mkdir -p $OUT/src/yaml
+	cp Makefile *.cpp *.h $OUT/src
+	cp yaml/*.cpp yaml/*.h $OUT/src/yaml
+	make -C $OUT/src "$@" > $OUT/build.log 2>&1 || { cat $OUT/build.log; echo "Build failed"; rm -rf $OUT; exit 1; }
+	mv $OUT/src/ray $OUT/$name
+	rm -rf $OUT/src
+}
+
+build ray-double COLOR_SCALAR=double
+build ray-float
+
+# Prints the time in milliseconds and the peak memory in kB of one render
+run()
+{
+	start=`date +%s%N`
+	$OUT/$1 $2 $OUT/out > $OUT/log 2>&1 || { echo "failed - -"; return; }
+	end=`date +%s%N`
+	memory=`sed -n 's/^Peak memory: \([0-9]*\) kB$/\1/p' $OUT/log`
+	echo "ok $(( (end - start)/1000000 )) $memory"
+}
+
+printf "%-50s %10s %10s %12s %12s\n" scene "ms double" "ms float" "kB double" "kB float"
+for scene in "$@"; do
+	set -- `run ray-double $scene`
+	doubleStatus=$1; doubleTime=$2; doubleMemory=$3
+	set -- `run ray-float $scene`
+	if [ "$doubleStatus" != ok ] || [ "$1" != ok ]; then
+		printf "%-50s %s\n" `basename $scene .yaml` "failed to render"
+		continue
+	fi
+	printf "%-50s %10s %10s %12s %12s\n" `basename $scene .yaml` $doubleTime $2 $doubleMemory $3
+done
+
+rm -rf $OUT
@@ -0,0 +1,198 @@
+//
+//  Framework for a raytracer
+//  File: bvh.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "bvh.h"
+#include <algorithm>
+#include <limits>
+
+// Tells whether a primitive's center falls in one of the first few SAH buckets
+class InLowerBuckets
+{
+public:
+	InLowerBuckets(const std::vector<Point> &centers, int axis, double min, double scale, int split)
+		: centers(centers), axis(axis), min(min), scale(scale), split(split) { }
+	bool operator()(unsigned int a) const
+	{ return bucket(centers[a].data[axis], min, scale) < split; }
+
+	static int bucket(double c, double min, double scale)
+	{
+		int b = (int)((c - min) * scale);
+		return b < 0 ? 0 : (b >= BVH_SAH_BUCKETS ? BVH_SAH_BUCKETS - 1 : b);
+	}
+private:
+	const std::vector<Point> &centers;
+	int axis;
+	double min, scale;
+	int split;
+};
+
+// Sorts primitive indices by the position of their center along one axis
+class CenterLess
+{
+public:
+	CenterLess(const std::vector<Point> &centers, int axis) : centers(centers), axis(axis) { }
+	bool operator()(unsigned int a, unsigned int b) const
+	{ return centers[a].data[axis] < centers[b].data[axis]; }
+private:
+	const std::vector<Point> &centers;
+	int axis;
+};
+
+void BVH::build(const std::vector<AABB> &bounds, unsigned int maxLeafSize)
+{
+	nodes.clear();
+	indices.clear();
+	leafCount = 0;
+	depth = 0;
+	if (bounds.empty())
+		return;
+	if (maxLeafSize < 1)
+		maxLeafSize = 1;
+
+	std::vector<Point> centers;
+	centers.reserve(bounds.size());
+	indices.reserve(bounds.size());
+	for (unsigned int i = 0; i < bounds.size(); i++) {
+		centers.push_back(bounds[i].center());
+		indices.push_back(i);
+	}
+
+	// A binary tree with at most one leaf per primitive has less than 2n nodes
+	nodes.reserve(2*bounds.size());
+	nodes.push_back(Node());
+	buildNode(0, 0, bounds.size(), 0, bounds, centers, maxLeafSize);
+}
+
+void BVH::buildNode(unsigned int nodeIndex, unsigned int start, unsigned int end, unsigned int nodeDepth,
+	const std::vector<AABB> &bounds, const std::vector<Point> &centers, unsigned int maxLeafSize)
+{
+	// Relative cost of traversing a node and intersecting a primitive
+	static const double costTraversal = 1.0, costIntersect = 1.0;
+
+	AABB box, centerBox;
+	for (unsigned int i = start; i < end; i++) {
+		box.extend(bounds[indices[i]]);
+		centerBox.extend(centers[indices[i]]);
+	}
+	// Guard against roundoff when rays graze flat boxes
+	box.pad(1e-7 * (1.0 + box.extent().length()));
+	nodes[nodeIndex].bounds = box;
+	if (nodeDepth > depth)
+		depth = nodeDepth;
+
+	unsigned int n = end - start;
+	if (n == 1 || nodeDepth >= MAX_DEPTH) {
+		makeLeaf(nodeIndex, start, n);
+		return;
+	}
+
+	/*
+	 * Surface area heuristic: the probability that a ray that hits this
+	 * node also hits a child is proportional to the child's surface area,
+	 * so the expected cost of a split is
+	 *   costTraversal + costIntersect*(A_left*n_left + A_right*n_right)/A
+	 * Sort the centers into buckets along every axis, evaluate every
+	 * split between two buckets and pick the cheapest one.
+	 */
+	double bestCost = std::numeric_limits<double>::max();
+	int bestAxis = -1, bestSplit = 0;
+	double area = box.surfaceArea();
+	Vector centerExtent = centerBox.extent();
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (centerExtent.data[axis] <= 0.0)
+			continue;
+		double scale = BVH_SAH_BUCKETS / centerExtent.data[axis];
+
+		AABB bucketBox[BVH_SAH_BUCKETS];
+		unsigned int bucketCount[BVH_SAH_BUCKETS] = { 0 };
+		for (unsigned int i = start; i < end; i++) {
+			int b = InLowerBuckets::bucket(centers[indices[i]].data[axis], centerBox.min.data[axis], scale);
+			bucketCount[b]++;
+			bucketBox[b].extend(bounds[indices[i]]);
+		}
+
+		// Sweep from the right to get the area and count of everything
+		// above every split, then from the left to evaluate the splits
+		double rightArea[BVH_SAH_BUCKETS];
+		unsigned int rightCount[BVH_SAH_BUCKETS];
+		AABB right;
+		unsigned int count = 0;
+		for (int b = BVH_SAH_BUCKETS - 1; b > 0; b--) {
+			right.extend(bucketBox[b]);
+			count += bucketCount[b];
+			rightArea[b] = right.surfaceArea();
+			rightCount[b] = count;
+		}
+
+		AABB left;
+		count = 0;
+		for (int split = 1; split < BVH_SAH_BUCKETS; split++) {
+			left.extend(bucketBox[split - 1]);
+			count += bucketCount[split - 1];
+			if (count == 0 || rightCount[split] == 0)
+				continue;
+			double cost = costTraversal + costIntersect *
+				(left.surfaceArea()*count + rightArea[split]*rightCount[split]) / area;
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	// Stop if splitting isn't worth it, unless the leaf would become too big
+	double leafCost = costIntersect * n;
+	if (n <= maxLeafSize && (bestAxis < 0 || bestCost >= leafCost)) {
+		makeLeaf(nodeIndex, start, n);
+		return;
+	}
+
+	unsigned int mid;
+	if (bestAxis >= 0) {
+		double scale = BVH_SAH_BUCKETS / centerExtent.data[bestAxis];
+		mid = std::partition(indices.begin() + start, indices.begin() + end,
+			InLowerBuckets(centers, bestAxis, centerBox.min.data[bestAxis], scale, bestSplit)) - indices.begin();
+	} else {
+		// All centers coincide, so the SAH can't separate them. Split
+		// in the middle of the list to keep leaves small.
+		mid = start + n/2;
+		std::nth_element(indices.begin() + start, indices.begin() + mid, indices.begin() + end,
+			CenterLess(centers, centerBox.largestAxis()));
+	}
+
+	// The left child goes directly after this node; the right child
+	// goes after the entire left subtree
+	unsigned int left = nodes.size();
+	nodes.push_back(Node());
+	buildNode(left, start, mid, nodeDepth + 1, bounds, centers, maxLeafSize);
+
+	unsigned int right = nodes.size();
+	nodes.push_back(Node());
+	buildNode(right, mid, end, nodeDepth + 1, bounds, centers, maxLeafSize);
+
+	nodes[nodeIndex].first = right;
+	nodes[nodeIndex].count = 0;
+}
+
+void BVH::makeLeaf(unsigned int nodeIndex, unsigned int start, unsigned int count)
+{
+	nodes[nodeIndex].first = start;
+	nodes[nodeIndex].count = count;
+	leafCount++;
+}
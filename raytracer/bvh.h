@@ -0,0 +1,165 @@
+//
+//  Framework for a raytracer
+//  File: bvh.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include "aabb.h"
+#include "hit.h"
+#include "ray.h"
+
+// Number of buckets primitive centers are sorted into when evaluating
+// the surface area heuristic
+#define BVH_SAH_BUCKETS 12
+
+/**
+ * Bounding volume hierarchy over an arbitrary list of primitives.
+ * The BVH only knows the bounding box of each primitive; intersecting
+ * the primitives themselves is left to an intersector functor passed
+ * to intersect(), which is called for every leaf the ray reaches as
+ *   Hit isect(unsigned int first, unsigned int count, const Ray &ray, bool closest, double maxT)
+ * and must return the closest hit (or, if closest is false, any hit)
+ * with primitives first .. first + count - 1 with a t value below maxT.
+ * build() reorders the primitives so that every leaf refers to a
+ * consecutive range. The owner must store its primitives in that order,
+ * see getOrder().
+ */
+class BVH
+{
+public:
+	struct Node
+	{
+		AABB bounds;
+		// For leaves, the primitives are first .. first + count - 1.
+		// For interior nodes count is 0, the left child is the node directly
+		// after this one and the right child is nodes[first].
+		unsigned int first, count;
+	};
+
+	BVH() : leafCount(0), depth(0) { }
+
+	/**
+	 * Build the hierarchy using the surface area heuristic.
+	 * @param bounds Bounding box of every primitive
+	 * @param maxLeafSize Largest number of primitives a leaf may hold. Smaller
+	 *                    leaves are created when the SAH says that's cheaper
+	 */
+	void build(const std::vector<AABB> &bounds, unsigned int maxLeafSize);
+
+	/**
+	 * Intersect a ray with the primitives in the hierarchy.
+	 * @param ray Ray to intersect with
+	 * @param closest If true, make sure to return the closest intersection. If false, stop at the first intersection
+	 * @param maxT Ignore intersections with a t value greater than or equal to this
+	 * @param isect Intersector functor, see above
+	 * @return Hit object
+	 */
+	template <class Intersector>
+	Hit intersect(const Ray &ray, bool closest, double maxT, Intersector &isect) const;
+
+	bool isEmpty() const { return nodes.empty(); }
+	AABB getBounds() const { return nodes.empty() ? AABB() : nodes[0].bounds; }
+	
+	// Build statistics
+	unsigned int getNodeCount() const { return nodes.size(); }
+	unsigned int getLeafCount() const { return leafCount; }
+	unsigned int getDepth() const { return depth; }
+	
+	/**
+	 * The order the primitives must be stored in: getOrder()[i] is the
+	 * index in the list passed to build() of the i'th primitive.
+	 */
+	const std::vector<unsigned int>& getOrder() const { return indices; }
+	const std::vector<Node>& getNodes() const { return nodes; }
+
+private:
+	// Deep enough for any tree build() produces, see MAX_DEPTH
+	static const int STACK_SIZE = 64;
+	static const unsigned int MAX_DEPTH = STACK_SIZE - 2;
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> indices;
+	unsigned int leafCount, depth;
+
+	void buildNode(unsigned int nodeIndex, unsigned int start, unsigned int end, unsigned int nodeDepth,
+		const std::vector<AABB> &bounds, const std::vector<Point> &centers, unsigned int maxLeafSize);
+	void makeLeaf(unsigned int nodeIndex, unsigned int start, unsigned int count);
+};
+
+template <class Intersector>
+Hit BVH::intersect(const Ray &ray, bool closest, double maxT, Intersector &isect) const
+{
+	Hit min_hit = Hit::NO_HIT();
+	if (nodes.empty())
+		return min_hit;
+
+	Vector invD = AABB::inverseDirection(ray.D);
+	double tNear, tLeft, tRight;
+	if (!nodes[0].bounds.intersect(ray, invD, maxT, &tNear))
+		return min_hit;
+
+	unsigned int stack[STACK_SIZE];
+	int sp = 0;
+	unsigned int current = 0;
+
+	while (true)
+	{
+		const Node &node = nodes[current];
+		if (node.count > 0)
+		{
+			Hit hit = isect(node.first, node.count, ray, closest, maxT);
+			if (hit.hasHit() && hit.t < maxT) {
+				min_hit = hit;
+				if (!closest)
+					return min_hit;
+				// Anything further away than this is no longer interesting
+				maxT = hit.t;
+			}
+		}
+		else
+		{
+			unsigned int left = current + 1, right = node.first;
+			bool hitLeft = nodes[left].bounds.intersect(ray, invD, maxT, &tLeft);
+			bool hitRight = nodes[right].bounds.intersect(ray, invD, maxT, &tRight);
+			if (hitLeft && hitRight) {
+				// Visit the nearest child first, so maxT shrinks as fast as possible
+				if (tRight < tLeft) {
+					stack[sp++] = left;
+					current = right;
+				} else {
+					stack[sp++] = right;
+					current = left;
+				}
+				continue;
+			} else if (hitLeft) {
+				current = left;
+				continue;
+			} else if (hitRight) {
+				current = right;
+				continue;
+			}
+		}
+
+		if (sp == 0)
+			break;
+		current = stack[--sp];
+	}
+
+	return min_hit;
+}
+
+#endif /* end of include guard: BVH_H */
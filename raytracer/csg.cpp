@@ -22,93 +22,143 @@
 #include <algorithm>
 
 
-Hit Csg::intersect(const Ray &ray, bool closest, double maxT)
+void Csg::initBounds()
 {
-	// translate ray
-	Ray r(ray.O - position, ray.D);
+	bounds1 = o1->getBounds();
+	bounds2 = o2->getBounds();
+	// Guard against roundoff when rays graze flat boxes, like the BVH does
+	if (!bounds1.isEmpty() && !bounds1.isInfinite())
+		bounds1.pad(1e-7 * (1.0 + bounds1.extent().length()));
+	if (!bounds2.isEmpty() && !bounds2.isInfinite())
+		bounds2.pad(1e-7 * (1.0 + bounds2.extent().length()));
 	
-	// select the correct set algorithm
-	Hit hit = Hit::NO_HIT();
 	switch (op)
 	{
 		case opIntersect:
-			hit = isect(r);
+			// The overlap of both boxes, which is empty if they are apart
+			bounds = bounds1;
+			for (int i = 0; i < 3; i++) {
+				bounds.min.data[i] = std::max(bounds1.min.data[i], bounds2.min.data[i]);
+				bounds.max.data[i] = std::min(bounds1.max.data[i], bounds2.max.data[i]);
+			}
 			break;
 		case opDifference:
-			hit = diff(r);
+			bounds = bounds1;
 			break;
 		case opUnion:
 		default:
-			hit = closestHit(r);
+			bounds = bounds1;
+			bounds.extend(bounds2);
 			break;
 	}
-	hit.makeObj(this);
-	return hit;
 }
 
+/**
+ * Whether a line can meet anything inside a box
+ * @param invD Componentwise inverse of the line's direction
+ */
+static inline bool mayHit(const AABB &box, const Ray &ray, const Vector &invD)
+{
+	if (box.isEmpty())
+		return false;
+	return box.isInfinite() || box.intersectsLine(ray, invD);
+}
 
-Hit Csg::closestHit(const Ray &ray)
+Hit Csg::intersect(const Ray &ray, bool closest, double maxT)
 {
-	// simply pick the closest hit
-	static const double inf = std::numeric_limits<double>::infinity();
-	Hit h1 = o1->intersect(ray, true, inf);
-	Hit h2 = o2->intersect(ray, true, inf);
+	// Rays that miss the box can't hit either child where it counts
+	if (bounds.isEmpty())
+		return Hit::NO_HIT();
+	if (!bounds.isInfinite()) {
+		Ray r(getWorldToObject().apply(ray.O), ray.D);
+		double tNear;
+		if (!bounds.intersect(r, AABB::inverseDirection(r.D), maxT, &tNear))
+			return Hit::NO_HIT();
+	}
+	
+	SpanList spans;
+	getSpans(ray, &spans);
 	
-	return ( (h1.t < h2.t) ? h1 : h2);
+	// The first place at or after the ray's origin where it goes in or out
+	for (unsigned int i = 0; i < spans.size(); i++) {
+		if (spans[i].in.t >= 0)
+			return spans[i].in;
+		if (spans[i].out.t >= 0 && spans[i].out.t < std::numeric_limits<double>::infinity())
+			return spans[i].out;
+	}
+	return Hit::NO_HIT();
 }
 
-Hit Csg::isect(Ray ray)
+void Csg::getSpans(const Ray &ray, SpanList *spans)
 {
-	bool in1 = false, in2 = false;
-	double t = 0.0;
+	// move the ray into the space of the sub-objects
+	Ray r(getWorldToObject().apply(ray.O), ray.D);
 	
-	Hit hit = Hit::NO_HIT();
-	// continue searching while we're not in both objects
-	while(!(in1 && in2))
+	// Both children are intersected once, over the whole ray, unless the
+	// line misses their box
+	Vector invD = AABB::inverseDirection(r.D);
+	SpanList spans1, spans2;
+	if (mayHit(bounds1, r, invD))
+		o1->getSpans(r, &spans1);
+	// Without o1 there is nothing to intersect with or subtract from
+	if (spans1.empty() && op != opUnion)
+		return;
+	if (mayHit(bounds2, r, invD))
+		o2->getSpans(r, &spans2);
+	combine(spans1, spans2, spans);
+}
+
+bool Csg::isInside(bool in1, bool in2) const
+{
+	switch (op)
 	{
-		hit = closestHit(ray);
-		// terminate if there's no intersection anymore
-		if (!hit.hasHit()) return hit;
-		
-		// if we're entering or leaving, flip bit
-		if (hit.obj == o1) in1 = !in1;
-		else in2 = !in2;
-		
-		// start tracing again from the intersection position
-		hit.t += 0.01;
-		t += hit.t;
-		ray = Ray(ray.O + hit.t*ray.D, ray.D);
+		case opIntersect:
+			return in1 && in2;
+		case opDifference:
+			return in1 && !in2;
+		case opUnion:
+		default:
+			return in1 || in2;
 	}
-	
-	// use all the added t's, without the last added delta
-	hit.t = t-0.01;
-	return hit;
 }
 
-Hit Csg::diff(Ray ray)
+void Csg::combine(const SpanList &spans1, const SpanList &spans2, SpanList *result)
 {
-	bool in1 = false, in2 = false;
-	double t = 0.0;
-	
-	Hit hit = Hit::NO_HIT();
-	// continue searching while it's not the case that we're in object 1, but not in object 2
-	while(!(in1 && !in2))
+	// Walk along the ray over the span boundaries of both children, in
+	// order, and keep track of whether the ray is inside each of them.
+	// Wherever that changes whether it's inside the result, a span of the
+	// result starts or ends.
+	unsigned int i1 = 0, i2 = 0; // next span
+	bool in1 = false, in2 = false; // inside that child, i.e. its next boundary is the end of a span
+	bool inside = false;
+	Span span;
+	while (i1 < spans1.size() || i2 < spans2.size())
 	{
-		hit = closestHit(ray);
-		// terminate if there's no intersection anymore
-		if (!hit.hasHit()) return hit;
+		const Hit *next1 = i1 < spans1.size() ? (in1 ? &spans1[i1].out : &spans1[i1].in) : NULL;
+		const Hit *next2 = i2 < spans2.size() ? (in2 ? &spans2[i2].out : &spans2[i2].in) : NULL;
+		Hit boundary = Hit::NO_HIT();
+		if (next1 && (!next2 || next1->t <= next2->t)) {
+			boundary = *next1;
+			if (in1)
+				i1++;
+			in1 = !in1;
+		} else {
+			boundary = *next2;
+			if (in2)
+				i2++;
+			in2 = !in2;
+		}
 		
-		// if we're entering or leaving, flip bit
-		if (hit.obj == o1) in1 = !in1;
-		else in2 = !in2;
-		
-		// start tracing again from the intersection position
-		hit.t += 0.01;
-		t += hit.t;
-		ray = Ray(ray.O + hit.t*ray.D, ray.D);
+		if (isInside(in1, in2) == inside)
+			continue;
+		inside = !inside;
+		boundary.obj = this;
+		boundary.entering = inside;
+		if (inside) {
+			span.in = boundary;
+		} else {
+			span.out = boundary;
+			result->push_back(span);
+		}
 	}
-	
-	// use all the added t's, without the last added delta
-	hit.t = t-0.01;
-	return hit;
 }
@@ -29,20 +29,27 @@ public:
 	};
 	
 	Csg(Object *o1, Object *o2, Point pos, Csg::Operation op) : Object(Vector(0, 0, 1), 0.0), 
-		o1(o1), o2(o2), position(pos), op(op)  { }
+		o1(o1), o2(o2), position(pos), op(op)  { setTransform(Transform(Matrix(), pos)); initBounds(); }
 
 	virtual Hit intersect(const Ray &ray, bool closest, double maxT);
+	virtual void getSpans(const Ray &ray, SpanList *spans);
 	virtual Point getRotationCenter() { return position; }
-	virtual void getTexCoords(const Point &p, double &x, double &y) { o1->getTexCoords(p-position, x, y); }
-	virtual Point getPointFromTexCoords(double u, double v) { return o1->getPointFromTexCoords(u, v) + position; }
+	virtual void getTexCoords(const Point &p, double &x, double &y) { o1->getTexCoords(getWorldToObject().apply(p), x, y); }
+	virtual Point getPointFromTexCoords(double u, double v) { return getObjectToWorld().apply(o1->getPointFromTexCoords(u, v)); }
+	virtual AABB getBounds() { return bounds.transformed(getObjectToWorld()); }
 	
 	Object *o1, *o2;
 	Point position;
 	Operation op;
 private:
-	Hit closestHit(const Ray &ray);
-	Hit isect(Ray ray);
-	Hit diff(Ray ray);
+	// Boxes around o1, o2 and the result of op on them, in the space of
+	// the children. The children must not change after they are combined.
+	AABB bounds1, bounds2, bounds;
+	
+	void initBounds();
+	bool isInside(bool in1, bool in2) const;
+	// Combine the spans of o1 and o2 with op
+	void combine(const SpanList &spans1, const SpanList &spans2, SpanList *result);
 };
 
 #endif /* end of include guard: CSG_H */
@@ -19,8 +19,60 @@
 #include "cylinder.h"
 #include <iostream>
 #include <math.h>
+#include <algorithm>
 
 Hit Cylinder::intersect(const Ray &ray, bool closest, double maxT)
+{
+	return intersect(getWorldToObject(), getObjectToWorld(), r, L, ray, this);
+}
+
+Hit Cylinder::intersect(const Transform &worldToObject, const Transform &objectToWorld, double r, double L,
+	const Ray &ray, Object *obj)
+{
+	// The intersection computation takes place in the cylinder's own
+	// space, where A=(0,0,0) and B=(L,0,0). Transform the ray to it; the
+	// transform only rotates, so D keeps its length and t its meaning.
+	Point O = worldToObject.apply(ray.O);
+	Vector D = worldToObject.applyDirection(ray.D);
+	
+	double t1, t2;
+	if (!solidSpan(O, D, r, L, &t1, &t2))
+		return Hit::NO_HIT();
+	bool t1Valid = t1 >= 0;
+	bool t2Valid = t2 >= 0;
+	
+	// If both t1 and t2 are invalid, there is no intersection
+	if (!t1Valid && !t2Valid)
+		return Hit::NO_HIT();
+	// Choose the lowest valid t
+	double t = t1Valid && t1 <= t2 ? t1 : t2;
+	
+	// Transform the normal back to the world system
+	Vector N = objectToWorld.applyDirection(normal(O + t*D, r, L)).normalized();
+	
+	// If the intersection was on the inside of the cylinder,
+	// flip the normal
+	if (!t1Valid)
+		N = -N;
+	
+	return Hit(t,N, obj, t1Valid);
+}
+
+void Cylinder::getSpans(const Ray &ray, SpanList *spans)
+{
+	Point O = getWorldToObject().apply(ray.O);
+	Vector D = getWorldToObject().applyDirection(ray.D);
+	double t1, t2;
+	if (!solidSpan(O, D, r, L, &t1, &t2))
+		return;
+	
+	Span span;
+	span.in = Hit(t1, getObjectToWorld().applyDirection(normal(O + t1*D, r, L)).normalized(), this, true);
+	span.out = Hit(t2, -getObjectToWorld().applyDirection(normal(O + t2*D, r, L)).normalized(), this, false);
+	spans->push_back(span);
+}
+
+bool Cylinder::solidSpan(const Point &O, const Vector &D, double r, double L, double *tIn, double *tOut)
 {
 	/*
 	 * Line-cylinder intersection derivation (own work).
@@ -38,12 +90,6 @@ Hit Cylinder::intersect(const Ray &ray, bool closest, double maxT)
 	 * of O+t*D is between 0 and L (=|B-A|).
 	 */
 	
-	// The intersection computation takes place in a translated and rotated
-	// system where A=(0,0,0) and B=(L,0,0)
-	// Transform the ray to this system
-	Point O = rotToX*(ray.O - A);
-	Vector D = (rotToX*ray.D).normalized();
-	
 	// Quadratic formula
 	double a = D.y*D.y + D.z*D.z;
 	double b = 2*O.y*D.y + 2*O.z*D.z;
@@ -51,17 +97,13 @@ Hit Cylinder::intersect(const Ray &ray, bool closest, double maxT)
 	double d = b*b - 4*a*c;
 	if (d < 0)
 		// No solutions
-		return Hit::NO_HIT();
+		return false;
 	double sqrtD = sqrt(d);
 	double t1 = (-b - sqrtD)/(2*a);
 	double t2 = (-b + sqrtD)/(2*a);
-	
-	// Check validity of t1 and t2
-	double L = (B - A).length();
 	Point atT1 = O + t1*D, atT2 = O + t2*D;
-	bool t1Valid = t1 >= 0 && (atT1.x >= 0 && atT1.x <= L);
-	bool t2Valid = t2 >= 0 && (atT2.x >= 0 && atT2.x <= L);
-	double t;
+	bool t1Inside = atT1.x >= 0 && atT1.x <= L;
+	bool t2Inside = atT2.x >= 0 && atT2.x <= L;
 	
 	/* Our cylinders are massive, not hollow.
 	 * If the ray intersects the circle around A or B, we care
@@ -72,73 +114,75 @@ Hit Cylinder::intersect(const Ray &ray, bool closest, double maxT)
 	 * intersection point with the x=0 plane (for A) or x=L plane (for B),
 	 * which will automatically be inside the circle because it's between
 	 * the entry and exit points.
-	 * 
-	 * TODO: Implement this in a simpler way by unconditionally computing
-	 * the intersections. This is not hard as long as it's done inside
-	 * this function, so we can intersect with x=0 and x=L instead of
-	 * some arbitrary plane.
 	 */
 	if (atT1.x < 0 && atT2.x >= 0) {
 		// Set t1 to where the ray intersects the x=0 plane
 		// This will happen within the cylinder because atT2.x >= 0
 		t1 += -atT1.x / D.x;
 		atT1 = O + t1*D;
-		t1Valid = t1 >= 0;
+		t1Inside = true;
 	}
 	if (atT2.x < 0 && atT1.x >= 0) {
 		// Same as above, with t1 and t2 reversed
 		t2 += -atT2.x / D.x;
 		atT2 = O + t2*D;
-		t2Valid = t2 >= 0;
+		t2Inside = true;
 	}
 	if (atT1.x <= L && atT2.x > L) {
 		// Set t2 to where the ray intersects the x=L plane
 		// This will happen within the cylinder because atT1.x <= L
 		t2 -= (atT2.x - L) / D.x;
 		atT2 = O + t2*D;
-		t2Valid = t2 >= 0;
+		t2Inside = true;
 	}
 	if (atT2.x <= L && atT1.x > L) {
 		// Same as above, with t1 and t2 reversed
 		t1 -= (atT1.x - L) / D.x;
 		atT1 = O + t1*D;
-		t1Valid = t1 >= 0;
+		t1Inside = true;
 	}
 	
-	// If both t1 and t2 are invalid, there is no intersection
-	if (!t1Valid && !t2Valid)
-		return Hit::NO_HIT();
-	// Choose the lowest valid t
-	t = t1Valid && t1 <= t2 ? t1 : t2;
-	
-	// Compute the normal
-	Vector N;
-	Point P = O + t*D;
+	// If the infinite cylinder is crossed entirely on one side of A or B,
+	// the ray misses
+	if (!t1Inside || !t2Inside)
+		return false;
+	*tIn = t1;
+	*tOut = t2;
+	return true;
+}
+
+Vector Cylinder::normal(const Point &P, double r, double L)
+{
 	Point Pproj(P.x, 0, 0);
 	if (fabs((P - Pproj).length_2() - r*r) < 0.01)
 		// P is on the cylinder
-		N = P - Pproj;
+		return P - Pproj;
 	// else P is on a bounding circle. Figure out which one
 	else if (Pproj.x - L/2 < 0)
 		// P is on the circle around A
-		N = B - A;
+		return Vector(-1, 0, 0);
 	else
 		// P is on the circle around B
-		N = A - B;
-	
-	// Transform the normal back to the world system
-	N = (invRotToX*N).normalized();
-	
-	// If the intersection was on the inside of the cylinder,
-	// flip the normal
-	if (!t1Valid)
-		N = -N;
-	
-	return Hit(t,N, this);
+		return Vector(1, 0, 0);
 }
 
 Point Cylinder::getRotationCenter()
 {
 	// The middle of the line from a to b
 	return (A + B)/2;
-}
\ No newline at end of file
+}
+
+AABB Cylinder::getBounds()
+{
+	// The end caps are discs of radius r perpendicular to the axis. Along
+	// each coordinate axis i such a disc extends r*sqrt(1 - u_i^2) from
+	// its center, where u is the normalized axis of the cylinder.
+	Vector u = (B - A).normalized();
+	Vector e(r*sqrt(max(0.0, 1 - u.x*u.x)), r*sqrt(max(0.0, 1 - u.y*u.y)), r*sqrt(max(0.0, 1 - u.z*u.z)));
+	AABB box;
+	box.extend(A - e);
+	box.extend(A + e);
+	box.extend(B - e);
+	box.extend(B + e);
+	return box;
+}
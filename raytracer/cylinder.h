@@ -25,25 +25,43 @@ class Cylinder : public Object
 {
 public:
 	Cylinder(Point axisStart, Point axisEnd, double radius, Vector &rot, double angle) :
-			Object(rot, angle), A(axisStart), B(axisEnd), r(radius) {
-		// FIXME: Doesn't take rotations into account
-		// Precompute rotations needed for intersect()
-		rotToX = Matrix::rotationOntoXAxis(B - A, &invRotToX);
+			Object(rot, angle), A(rotate(axisStart, (axisStart + axisEnd)/2)), B(rotate(axisEnd, (axisStart + axisEnd)/2)),
+			r(radius), L((axisEnd - axisStart).length()) {
+		// The cylinder's own space has A in the origin and B on the positive x axis
+		Matrix fromX;
+		Matrix::rotationOntoXAxis(B - A, &fromX);
+		setTransform(Transform(fromX, A));
 	}
 
 	virtual Hit intersect(const Ray &ray, bool closest, double maxT);
+	/**
+	 * Intersect a ray with a cylinder with radius r around the x axis from
+	 * x = 0 to x = L, which is placed in the world by the given transforms
+	 * @param obj Object the hit is reported for
+	 */
+	static Hit intersect(const Transform &worldToObject, const Transform &objectToWorld, double r, double L,
+		const Ray &ray, Object *obj);
+	virtual void getSpans(const Ray &ray, SpanList *spans);
 	virtual Point getRotationCenter();
+	virtual AABB getBounds();
 	// TODO: Textures
 	//virtual void getTexCoords(const Point &p, double &x, double &y);
 	//virtual Point getPointFromTexCoords(double u, double v);
 
 	const Point A, B;
 	const double r;
+	const double L; // length of the axis
 	
 	double getRadius() { return r; };
 
 private:
-	Matrix rotToX, invRotToX;
+	/**
+	 * Find where a ray in the cylinder's own space goes in and out of it
+	 * @return False if the ray misses the cylinder
+	 */
+	static bool solidSpan(const Point &O, const Vector &D, double r, double L, double *tIn, double *tOut);
+	// Outward normal at a point on the cylinder, in its own space
+	static Vector normal(const Point &P, double r, double L);
 };
 
 #endif /* end of include guard: CYLINDER_H */
@@ -21,6 +21,7 @@
 
 #include <iostream>
 #include <limits>
+#include <vector>
 #include "triple.h"
 
 class Object;
@@ -31,9 +32,20 @@ public:
 	double t;
 	Vector N;
 	Object *obj;
+	// True if the ray enters a solid object here, false if it leaves one
+	// or hits a surface that doesn't enclose anything
+	bool entering;
+	// For objects made of triangles (models), the triangle that was hit
+	// and the barycentric coordinates of the hit on it, see
+	// Triangle::intersect()
+	unsigned int triangle;
+	double beta, gamma;
+	// For hits reported for an instance, the object of the instance's
+	// group that was hit, see Instance::intersect()
+	Object *part;
 
-	Hit(const double t, const Vector &normal, Object *object)
-		: t(t), N(normal), obj(object)
+	Hit(const double t, const Vector &normal, Object *object, bool entering = false)
+		: t(t), N(normal), obj(object), entering(entering), triangle(0), beta(0), gamma(0), part(NULL)
 	{ }
 	
 	Hit() { Hit(std::numeric_limits<double>::infinity(),Vector(), NULL); }
@@ -48,4 +60,17 @@ public:
 	}
 };
 
+/**
+ * Part of a ray that lies inside an object, from the hit where the ray
+ * goes in to the hit where it comes out again. The normals of both hits
+ * face the ray, like those intersect() reports. A span that never ends
+ * has out.t set to infinity.
+ */
+struct Span
+{
+	Hit in, out;
+};
+
+typedef std::vector<Span> SpanList;
+
 #endif /* end of include guard: HIT_H */
@@ -21,39 +21,131 @@
 #include <string>
 #include <vector>
 
-std::map<std::string, Instance*> Instance::map;
+std::map<std::string, InstanceGroup*> Instance::groups;
 
-Instance::Instance(Point pos, const std::string &name) : Object(Vector(0, 0, 1), 0.0), position(pos)
+InstanceGroup::~InstanceGroup()
 {
-	 if (Instance::map.count(name))
-	 {
-	 	objects = Instance::map[name]->objects;
-	 	material = Instance::map[name]->material;
-	 }
-	 else
-	 {
-	 	objects = new std::vector<Object*>();
-	 	Instance::map[name] = this;
-	 }
+	for (unsigned int i = 0; i < objects.size(); ++i)
+		delete objects[i];
 }
 
-Hit Instance::intersect(const Ray &ray, bool closest, double maxT)
+void InstanceGroup::build()
 {
-	// Find hit object and distance
-	Hit min_hit = Hit::NO_HIT();
-	
-	Ray r(ray.O - position, ray.D);
+	std::vector<Object*> boundedObjects;
+	std::vector<AABB> bounds;
+	unboundedObjects.clear();
+	for (unsigned int i = 0; i < objects.size(); ++i) {
+		AABB box = objects[i]->getBounds();
+		if (box.isEmpty())
+			continue;
+		if (box.isInfinite()) {
+			unboundedObjects.push_back(objects[i]);
+		} else {
+			boundedObjects.push_back(objects[i]);
+			bounds.push_back(box);
+		}
+	}
+
+	bvh.build(bounds, 2);
+	primitives.clear();
+	const std::vector<unsigned int> &order = bvh.getOrder();
+	for (unsigned int i = 0; i < order.size(); ++i)
+		primitives.add(boundedObjects[order[i]]);
+	primitives.packQuads(bvh);
+}
+
+Hit InstanceGroup::intersect(const Ray &ray, bool closest, double maxT) const
+{
+	PrimitiveIntersector isect(primitives, NULL);
+	Hit min_hit = bvh.intersect(ray, closest, maxT, isect);
+	if (min_hit.hasHit() && !closest)
+		return min_hit;
 	
-	for (unsigned int i = 0; i < objects->size(); ++i) {
-		Hit hit = (*objects)[i]->intersect(r, closest, maxT);
+	for (unsigned int i = 0; i < unboundedObjects.size(); ++i) {
+		Hit hit = unboundedObjects[i]->intersect(ray, closest, maxT);
 		if (hit.hasHit() && (hit.t < min_hit.t || !min_hit.hasHit()) && hit.t < maxT) {
 			min_hit = hit;
 			if (!closest)
 				break;
 		}
 	}
+	return min_hit;
+}
+
+Instance::Instance(Point pos, const std::string &name, const Vector &rot, double angle, double scale)
+	: Object(rot, angle), position(pos), scale(scale)
+{
+	setTransform(Transform(rotation*Matrix::scale(scale), pos));
+
+	std::map<std::string, InstanceGroup*>::iterator it = groups.find(name);
+	if (it != groups.end()) {
+		group = it->second;
+	} else {
+		group = new InstanceGroup();
+		groups[name] = group;
+	}
+	group->acquire();
+}
+
+Hit Instance::intersect(const Ray &ray, bool closest, double maxT)
+{
+	// The objects are in the instance's own space. The ray direction is
+	// normalized there, so distances along it are divided by the scale.
+	// The group's BVH rejects rays that miss its box in that space.
+	Ray r(getWorldToObject().apply(ray.O), getWorldToObject().applyDirection(ray.D));
+	Hit hit = group->intersect(r, closest, maxT/scale);
+	if (!hit.hasHit())
+		return hit;
 	
-	if (material) min_hit.makeObj(this);
+	hit.t *= scale;
+	hit.N = getObjectToWorld().applyDirection(hit.N).normalized();
+	// Hits are shaded with the instance's material if it has one. The
+	// object that was hit is kept, so it can still be asked for its
+	// shading normal and texture coordinates.
+	if (material) {
+		hit.part = hit.obj;
+		hit.makeObj(this);
+	}
 	
-	return min_hit;
-}
\ No newline at end of file
+	return hit;
+}
+
+Hit Instance::getPartHit(const Hit &hit)
+{
+	Hit partHit = hit;
+	partHit.t /= scale;
+	partHit.N = getWorldToObject().applyDirection(hit.N).normalized();
+	partHit.obj = hit.part;
+	// A nested instance that was hit lost its own part when we took its
+	// place, so it falls back to the flat normal
+	partHit.part = NULL;
+	return partHit;
+}
+
+Vector Instance::getShadingNormal(const Hit &hit)
+{
+	if (!hit.part)
+		return hit.N;
+	Vector N = hit.part->getShadingNormal(getPartHit(hit));
+	return getObjectToWorld().applyDirection(N).normalized();
+}
+
+void Instance::getHitTexCoords(const Hit &hit, SurfaceInteraction *si)
+{
+	if (!hit.part) {
+		Object::getHitTexCoords(hit, si);
+		return;
+	}
+	
+	SurfaceInteraction partSi = *si;
+	partSi.obj = hit.part;
+	partSi.p = getWorldToObject().apply(si->p);
+	hit.part->getHitTexCoords(getPartHit(hit), &partSi);
+	si->u = partSi.u;
+	si->v = partSi.v;
+	si->hasDerivatives = partSi.hasDerivatives;
+	if (si->hasDerivatives) {
+		si->dpdu = getObjectToWorld().applyDirection(partSi.dpdu);
+		si->dpdv = getObjectToWorld().applyDirection(partSi.dpdv);
+	}
+}
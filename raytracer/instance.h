@@ -21,23 +21,77 @@
 
 #include "object.h"
 #include "triple.h"
+#include "bvh.h"
+#include "primitivestore.h"
 #include <vector>
 #include <string>
 #include <map>
 
+/**
+ * The objects an instance consists of, in the instance's own space. A
+ * group is shared by all instances with the same name, each of which
+ * holds a reference; the group and its objects are deleted once the last
+ * one is released. The group has its own BVH, so an instance costs no
+ * more per ray than intersecting the objects in the scene itself would.
+ */
+class InstanceGroup
+{
+public:
+	InstanceGroup() : refs(1) { }
+
+	void acquire() { refs++; }
+	void release() { if (--refs == 0) delete this; }
+
+	void addObject(Object *o) { objects.push_back(o); }
+	// (Re)build the BVH. Must be called after adding objects and before
+	// intersecting any rays.
+	void build();
+
+	Hit intersect(const Ray &ray, bool closest, double maxT) const;
+	// Box around the objects, in the space of the instances
+	AABB getBounds() const { return unboundedObjects.empty() ? bvh.getBounds() : AABB::infinite(); }
+
+private:
+	int refs;
+	std::vector<Object*> objects;
+	std::vector<Object*> unboundedObjects; // not in the BVH
+	BVH bvh;
+	PrimitiveStore primitives;
+
+	~InstanceGroup();
+};
+
 class Instance : public Object
 {
 public:
-	Instance(Point pos, const std::string &name);
-	~Instance() { delete objects; }
+	/**
+	 * The objects are scaled by scale and rotated around the instance's
+	 * origin, then moved to pos. Instances with the same name share their
+	 * objects: only the first one needs to list them.
+	 */
+	Instance(Point pos, const std::string &name, const Vector &rot, double angle, double scale);
+	~Instance() { group->release(); }
 	
 	virtual Hit intersect(const Ray &ray, bool closest, double maxT);
 	virtual Point getRotationCenter() { return position; }
-	void addObject(Object *o) { objects->push_back(o); }
+	virtual AABB getBounds() { return group->getBounds().transformed(getObjectToWorld()); }
+	// Ask the object that was hit, in the instance's own space
+	virtual Vector getShadingNormal(const Hit &hit);
+	virtual void getHitTexCoords(const Hit &hit, SurfaceInteraction *si);
+	void addObject(Object *o) { group->addObject(o); }
+	// Call after adding objects, see InstanceGroup::build()
+	void build() { group->build(); }
 	
 	Point position;
-	std::vector<Object*> *objects;
-	static std::map<std::string, Instance*> map;
+	double scale;
+
+private:
+	InstanceGroup *group;
+	
+	// The hit as the object that was hit reported it, in the instance's space
+	Hit getPartHit(const Hit &hit);
+	// The groups by name. The map holds a reference to every group.
+	static std::map<std::string, InstanceGroup*> groups;
 };
 
 #endif /* end of include guard: INSTANCE_H */
@@ -41,6 +41,7 @@ public:
 
 	virtual Hit intersect(const Ray &ray, bool closest, double maxT);
 	virtual Point getRotationCenter() { return position; }
+	virtual AABB getBounds() { return boundingSphere->getBounds(); }
 };
 
 #endif /* end of include guard: LIGHT_H_PG2BAJRA */
@@ -17,6 +17,7 @@
 //
 
 #include "raytracer.h"
+#include <sys/resource.h>
 
 int main(int argc, char *argv[])
 {
@@ -56,5 +57,10 @@ int main(int argc, char *argv[])
 	
 	raytracer.renderToFile(ofname);
 
+	// Report peak memory use, see benchmark.sh
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		cout << "Peak memory: " << usage.ru_maxrss << " kB" << endl;
+
 	return 0;
 }
@@ -20,12 +20,21 @@ Matrix Matrix::transposed() const {
 	return Matrix(Vector(r1.x, r2.x, r3.x), Vector(r1.y, r2.y, r3.y), Vector(r1.z, r2.z, r3.z));
 }
 
-Vector Matrix::operator*(const Vector &v)
+Matrix Matrix::inverse() const
+{
+	// The columns of the inverse are the cross products of the rows,
+	// divided by the determinant
+	Vector c1 = r2.cross(r3), c2 = r3.cross(r1), c3 = r1.cross(r2);
+	double det = r1.dot(c1);
+	return Matrix(c1/det, c2/det, c3/det).transposed();
+}
+
+Vector Matrix::operator*(const Vector &v) const
 {
 	return Vector(r1.dot(v), r2.dot(v), r3.dot(v));
 }
 
-Matrix Matrix::operator*(const Matrix &m)
+Matrix Matrix::operator*(const Matrix &m) const
 {
 	Matrix t = m.transposed();
 	return Matrix(t*r1, t*r2, t*r3);
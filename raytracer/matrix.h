@@ -27,8 +27,10 @@ public:
 	Matrix() : r1(Vector(1, 0, 0)), r2(Vector(0, 1, 0)), r3(Vector(0, 0, 1)) { }
 	
 	Matrix transposed() const;
-	Vector operator*(const Vector &v);
-	Matrix operator*(const Matrix &m);
+	// Only valid for matrices with a non-zero determinant
+	Matrix inverse() const;
+	Vector operator*(const Vector &v) const;
+	Matrix operator*(const Matrix &m) const;
 	
 	/**
 	 * Compute a rotation matrix
@@ -43,6 +45,11 @@ public:
 	 */
 	inline static const Matrix rotationDeg(const Vector &v, double angle) { return Matrix::rotation(v, angle*M_PI/180); }
 	
+	/**
+	 * Compute a matrix that scales by s in every direction
+	 */
+	inline static const Matrix scale(double s) { return Matrix(Vector(s, 0, 0), Vector(0, s, 0), Vector(0, 0, s)); }
+	
 	/**
 	 * Compute a rotation matrix that will rotate v onto the x axis
 	 * @param v Vector to rotate onto the x axis
@@ -0,0 +1,412 @@
+//
+//  Framework for a raytracer
+//  File: mesh.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Maarten Everts
+//    Jasper van de Gronde
+//
+//  This framework is inspired by and uses code of the raytracer framework of 
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html 
+//
+//    Roan Kattouw
+//    Jan Paul Posma
+
+#include "mesh.h"
+#include "triangle.h"
+#include "objloader.h"
+#include <cstdio>
+#include <cstdlib>
+#include <math.h>
+#include <omp.h>
+
+MeshCache::Map MeshCache::meshes;
+
+Mesh::Mesh(const std::string &filename, double size) : refs(1)
+{
+	double start = omp_get_wtime();
+	ObjLoader obj;
+	if (!obj.load(filename))
+		exit(1);
+	positions.swap(obj.positions);
+	normals.swap(obj.normals);
+	texCoords.swap(obj.texCoords);
+	indices.swap(obj.indices);
+	normalIndices.swap(obj.normalIndices);
+	texCoordIndices.swap(obj.texCoordIndices);
+	for (unsigned int i = 0; i < normals.size(); i++)
+		normals[i].normalize();
+	printf("Read %s: %u vertices, %u normals, %u texture coordinates, %u triangles in %.1f ms\n",
+		filename.c_str(), (unsigned int)positions.size(), (unsigned int)normals.size(),
+		(unsigned int)texCoords.size(), getNumTriangles(), (omp_get_wtime() - start)*1000.0);
+	
+	unitize(size);
+	preprocess(filename);
+	buildBVH(filename);
+}
+
+/**
+ * Center the mesh on the origin and scale it to the size it was loaded
+ * with, the way glmUnitize() and glmScale() used to: the largest of the
+ * width, height and depth becomes 2*size/1.5. Note that, like glm, this
+ * measures the model from the origin rather than from its center.
+ */
+void Mesh::unitize(double size)
+{
+	if (positions.empty())
+		return;
+	AABB box;
+	for (unsigned int i = 0; i < positions.size(); i++)
+		box.extend(positions[i]);
+	
+	Point center = box.center();
+	double extent = 0;
+	for (int i = 0; i < 3; i++)
+		extent = std::max(extent, fabs(box.max.data[i]) + fabs(box.min.data[i]));
+	// We want to use a bounding sphere instead of a bounding cube;
+	// therefore, scale down with 1.5
+	double scale = 2.0/extent * size/1.5;
+	
+	for (unsigned int i = 0; i < positions.size(); i++)
+		positions[i] = (positions[i] - center)*scale;
+}
+
+/**
+ * Weld vertices that are (almost) in the same place and remove the
+ * triangles that are left without area. Scanned and exported meshes are
+ * full of both, and they only cost memory and BVH nodes.
+ */
+void Mesh::preprocess(const std::string &filename)
+{
+	double start = omp_get_wtime();
+	unsigned int numVertices = positions.size(), numTriangles = getNumTriangles();
+	
+	// Tolerances relative to the size of the mesh
+	AABB box;
+	for (unsigned int i = 0; i < positions.size(); i++)
+		box.extend(positions[i]);
+	double diagonal = box.isEmpty() ? 0.0 : box.extent().length();
+	unsigned int welded = weld(1e-7*diagonal);
+	unsigned int degenerate = removeDegenerates(1e-7*diagonal);
+	
+	printf("Preprocessed %s: welded %u of %u vertices, removed %u of %u triangles in %.1f ms\n",
+		filename.c_str(), welded, numVertices, degenerate, numTriangles, (omp_get_wtime() - start)*1000.0);
+}
+
+// Hash of a grid cell, see weld()
+static inline unsigned long long cellHash(long long x, long long y, long long z)
+{
+	return (unsigned long long)x*73856093ULL ^ (unsigned long long)y*19349663ULL ^ (unsigned long long)z*83492791ULL;
+}
+
+/**
+ * Make all triangle corners closer than epsilon to each other use the
+ * same vertex. Vertices are hashed into a grid of cells four times as
+ * large as epsilon, so finding the neighbours of a vertex only means
+ * looking at its own cell, and at the cells next to it if it's closer
+ * than epsilon to their side.
+ * @return Number of vertices that were merged into another one. Unused
+ *         vertices are left in place until orderVertices() drops them.
+ */
+unsigned int Mesh::weld(double epsilon)
+{
+	unsigned int n = positions.size();
+	if (n == 0 || epsilon <= 0)
+		return 0;
+	
+	unsigned int tableSize = 1;
+	while (tableSize < 2*n)
+		tableSize *= 2;
+	// Chains of kept vertices per hash bucket
+	std::vector<int> head(tableSize, -1), next(n, -1);
+	std::vector<unsigned int> remap(n);
+	double cellSize = 4*epsilon, epsilon2 = epsilon*epsilon;
+	unsigned int welded = 0;
+	
+	for (unsigned int i = 0; i < n; i++) {
+		const Point &p = positions[i];
+		long long cell[3];
+		int from[3], to[3];
+		for (int k = 0; k < 3; k++) {
+			double c = floor(p.data[k]/cellSize);
+			double offset = p.data[k] - c*cellSize;
+			cell[k] = (long long)c;
+			from[k] = offset < epsilon ? -1 : 0;
+			to[k] = cellSize - offset < epsilon ? 1 : 0;
+		}
+		
+		int found = -1;
+		for (int dx = from[0]; dx <= to[0] && found < 0; dx++)
+		for (int dy = from[1]; dy <= to[1] && found < 0; dy++)
+		for (int dz = from[2]; dz <= to[2] && found < 0; dz++) {
+			unsigned long long h = cellHash(cell[0] + dx, cell[1] + dy, cell[2] + dz);
+			for (int j = head[h & (tableSize - 1)]; j >= 0; j = next[j]) {
+				if ((positions[j] - p).length_2() <= epsilon2) {
+					found = j;
+					break;
+				}
+			}
+		}
+		
+		if (found >= 0) {
+			remap[i] = found;
+			welded++;
+		} else {
+			// Keep the vertex, in the bucket of its own cell
+			unsigned long long h = cellHash(cell[0], cell[1], cell[2]) & (tableSize - 1);
+			remap[i] = i;
+			next[i] = head[h];
+			head[h] = i;
+		}
+	}
+	
+	for (unsigned int i = 0; i < indices.size(); i++)
+		indices[i] = remap[indices[i]];
+	return welded;
+}
+
+/**
+ * Remove triangles with two corners at the same vertex or (nearly) no
+ * area, which no ray can hit.
+ * @param epsilon Triangles whose height over their longest side is no
+ *                more than this are removed
+ * @return Number of triangles removed
+ */
+unsigned int Mesh::removeDegenerates(double epsilon)
+{
+	unsigned int n = getNumTriangles(), kept = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		const unsigned int *corner = &indices[i*3];
+		if (corner[0] == corner[1] || corner[1] == corner[2] || corner[0] == corner[2])
+			continue;
+		// Twice the area is the longest side times the height over it
+		Vector e1 = vertex(i, 1) - vertex(i, 0), e2 = vertex(i, 2) - vertex(i, 0), e3 = e2 - e1;
+		double longest2 = std::max(e1.length_2(), std::max(e2.length_2(), e3.length_2()));
+		double area2 = e1.cross(e2).length_2();
+		if (area2 <= epsilon*epsilon*longest2)
+			continue;
+		
+		for (int k = 0; k < 3; k++) {
+			indices[kept*3 + k] = indices[i*3 + k];
+			if (!normalIndices.empty())
+				normalIndices[kept*3 + k] = normalIndices[i*3 + k];
+			if (!texCoordIndices.empty())
+				texCoordIndices[kept*3 + k] = texCoordIndices[i*3 + k];
+		}
+		kept++;
+	}
+	
+	indices.resize(kept*3);
+	if (!normalIndices.empty())
+		normalIndices.resize(kept*3);
+	if (!texCoordIndices.empty())
+		texCoordIndices.resize(kept*3);
+	return n - kept;
+}
+
+/**
+ * Renumber the vertices in the order the triangles first use them, and
+ * drop the vertices no triangle uses. With the triangles in BVH order,
+ * the triangles of a leaf then find their vertices close together.
+ * @return Number of vertices dropped
+ */
+unsigned int Mesh::orderVertices()
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(positions.size(), unused);
+	std::vector<Point> ordered;
+	ordered.reserve(positions.size());
+	for (unsigned int i = 0; i < indices.size(); i++) {
+		unsigned int &v = remap[indices[i]];
+		if (v == unused) {
+			v = ordered.size();
+			ordered.push_back(positions[indices[i]]);
+		}
+		indices[i] = v;
+	}
+	unsigned int dropped = positions.size() - ordered.size();
+	positions.swap(ordered);
+	return dropped;
+}
+
+// Put the corners of the triangles in the order of the BVH
+void Mesh::reorder(std::vector<unsigned int> *corners) const
+{
+	if (corners->empty())
+		return;
+	std::vector<unsigned int> unordered;
+	unordered.swap(*corners);
+	const std::vector<unsigned int> &order = bvh.getOrder();
+	corners->reserve(order.size()*3);
+	for (unsigned int i = 0; i < order.size(); i++) {
+		corners->push_back(unordered[order[i]*3+0]);
+		corners->push_back(unordered[order[i]*3+1]);
+		corners->push_back(unordered[order[i]*3+2]);
+	}
+}
+
+void Mesh::buildBVH(const std::string& filename)
+{
+	double start = omp_get_wtime();
+	
+	unsigned int n = getNumTriangles();
+	std::vector<AABB> bounds(n);
+	for (unsigned int i = 0; i < n; i++) {
+		bounds[i].extend(vertex(i, 0));
+		bounds[i].extend(vertex(i, 1));
+		bounds[i].extend(vertex(i, 2));
+	}
+	bvh.build(bounds, TRIANGLE_PACKET_WIDTH);
+	
+	// Store the triangles in the order the BVH wants them
+	reorder(&indices);
+	reorder(&normalIndices);
+	reorder(&texCoordIndices);
+	unsigned int dropped = orderVertices();
+	
+	// Pack the triangles of every leaf together
+	packets.clear();
+	leafPackets.assign(n, 0);
+	const std::vector<BVH::Node> &nodes = bvh.getNodes();
+	for (unsigned int i = 0; i < nodes.size(); i++) {
+		if (nodes[i].count == 0)
+			continue;
+		leafPackets[nodes[i].first] = packets.size();
+		for (unsigned int j = 0; j < nodes[i].count; j++) {
+			if (j % TRIANGLE_PACKET_WIDTH == 0)
+				packets.push_back(TrianglePacket());
+			unsigned int tri = nodes[i].first + j;
+			packets.back().set(j % TRIANGLE_PACKET_WIDTH, vertex(tri, 0), vertex(tri, 1), vertex(tri, 2), tri);
+		}
+	}
+	
+	printf("Mesh %s: %u triangles, %u vertices (%u unused removed), BVH with %u nodes (%u leaves), depth %u, built in %.1f ms, %lu kB\n",
+		filename.c_str(), n, (unsigned int)positions.size(), dropped, bvh.getNodeCount(), bvh.getLeafCount(), bvh.getDepth(),
+		(omp_get_wtime() - start)*1000.0, (unsigned long)(getMemorySize()/1024));
+}
+
+// Lets the BVH intersect rays with a mesh's triangle packets
+class TrianglePacketIntersector
+{
+public:
+	TrianglePacketIntersector(const Ray &ray, const std::vector<Point> &positions, const std::vector<unsigned int> &indices,
+		const std::vector<TrianglePacket> &packets, const std::vector<unsigned int> &leafPackets, Object *obj)
+		: packetRay(ray), positions(positions), indices(indices), packets(packets), leafPackets(leafPackets), obj(obj) { }
+	
+	Hit operator()(unsigned int first, unsigned int count, const Ray &ray, bool closest, double maxT)
+	{
+		unsigned int p = leafPackets[first];
+		unsigned int end = p + (count + TRIANGLE_PACKET_WIDTH - 1)/TRIANGLE_PACKET_WIDTH;
+		int best = -1;
+		double bestT = maxT, t, beta, gamma, bestBeta = 0, bestGamma = 0;
+		float packetT[TRIANGLE_PACKET_WIDTH];
+		for (; p < end; p++) {
+			int mask = packets[p].intersect(packetRay, (float)bestT, packetT);
+			// Confirm the candidates in double precision
+			for (int lane = 0; mask; lane++, mask >>= 1) {
+				if (!(mask & 1))
+					continue;
+				unsigned int i = packets[p].index[lane];
+				if (Triangle::intersect(vertex(i, 0), vertex(i, 1), vertex(i, 2), ray, &t, &beta, &gamma) && t < bestT) {
+					best = i;
+					bestT = t;
+					bestBeta = beta;
+					bestGamma = gamma;
+					if (!closest)
+						break;
+				}
+			}
+			if (best >= 0 && !closest)
+				break;
+		}
+		if (best < 0)
+			return Hit::NO_HIT();
+		// Models are closed meshes with their triangles facing outwards
+		Vector N = Triangle::normal(vertex(best, 0), vertex(best, 1), vertex(best, 2));
+		Hit hit(bestT, N, obj, N.dot(ray.D) < 0);
+		hit.triangle = best;
+		hit.beta = bestBeta;
+		hit.gamma = bestGamma;
+		return hit;
+	}
+	
+	const Point &vertex(unsigned int triangle, int corner) const { return positions[indices[triangle*3 + corner]]; }
+	
+	PacketRay packetRay;
+	const std::vector<Point> &positions;
+	const std::vector<unsigned int> &indices;
+	const std::vector<TrianglePacket> &packets;
+	const std::vector<unsigned int> &leafPackets;
+	Object *obj;
+};
+
+Hit Mesh::intersect(const Ray &ray, bool closest, double maxT, Object *obj) const
+{
+	TrianglePacketIntersector isect(ray, positions, indices, packets, leafPackets, obj);
+	return bvh.intersect(ray, closest, maxT, isect);
+}
+
+bool Mesh::getNormal(unsigned int triangle, double beta, double gamma, Vector *N) const
+{
+	if (normalIndices.empty())
+		return false;
+	const unsigned int *corners = &normalIndices[triangle*3];
+	if (corners[0] == ObjLoader::NO_INDEX || corners[1] == ObjLoader::NO_INDEX || corners[2] == ObjLoader::NO_INDEX)
+		return false;
+	*N = ((1 - beta - gamma)*normals[corners[0]] + beta*normals[corners[1]] + gamma*normals[corners[2]]).normalized();
+	return true;
+}
+
+bool Mesh::getTexCoords(unsigned int triangle, double beta, double gamma, double *u, double *v) const
+{
+	if (texCoordIndices.empty())
+		return false;
+	const unsigned int *corners = &texCoordIndices[triangle*3];
+	if (corners[0] == ObjLoader::NO_INDEX || corners[1] == ObjLoader::NO_INDEX || corners[2] == ObjLoader::NO_INDEX)
+		return false;
+	const TexCoord &t0 = texCoords[corners[0]], &t1 = texCoords[corners[1]], &t2 = texCoords[corners[2]];
+	*u = (1 - beta - gamma)*t0.u + beta*t1.u + gamma*t2.u;
+	// In OBJ files v goes up the texture, for us it goes down
+	*v = 1 - ((1 - beta - gamma)*t0.v + beta*t1.v + gamma*t2.v);
+	return true;
+}
+
+bool Mesh::getTexDerivatives(unsigned int triangle, Vector *dpdu, Vector *dpdv) const
+{
+	double u[3], v[3];
+	if (!getTexCoords(triangle, 0, 0, &u[0], &v[0]) || !getTexCoords(triangle, 1, 0, &u[1], &v[1])
+			|| !getTexCoords(triangle, 0, 1, &u[2], &v[2]))
+		return false;
+	
+	// Solve dp1 = du1*dpdu + dv1*dpdv and dp2 = du2*dpdu + dv2*dpdv
+	Vector dp1 = vertex(triangle, 1) - vertex(triangle, 0), dp2 = vertex(triangle, 2) - vertex(triangle, 0);
+	double du1 = u[1] - u[0], dv1 = v[1] - v[0], du2 = u[2] - u[0], dv2 = v[2] - v[0];
+	double det = du1*dv2 - dv1*du2;
+	if (fabs(det) < 1e-12)
+		return false;
+	*dpdu = (dv2*dp1 - dv1*dp2)/det;
+	*dpdv = (du1*dp2 - du2*dp1)/det;
+	return true;
+}
+
+size_t Mesh::getMemorySize() const
+{
+	return positions.size()*sizeof(Point) + normals.size()*sizeof(Vector) + texCoords.size()*sizeof(TexCoord)
+		+ (indices.size() + normalIndices.size() + texCoordIndices.size())*sizeof(unsigned int) + packets.size()*sizeof(TrianglePacket)
+		+ leafPackets.size()*sizeof(unsigned int) + bvh.getNodeCount()*sizeof(BVH::Node)
+		+ bvh.getOrder().size()*sizeof(unsigned int);
+}
+
+Mesh *MeshCache::get(const std::string &filename, double size)
+{
+	std::pair<std::string, double> key(filename, size);
+	Mesh *&mesh = meshes[key];
+	if (!mesh)
+		mesh = new Mesh(filename, size);
+	mesh->acquire();
+	return mesh;
+}
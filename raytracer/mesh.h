@@ -0,0 +1,128 @@
+//
+//  Framework for a raytracer
+//  File: mesh.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stddef.h>
+#include "triple.h"
+#include "hit.h"
+#include "ray.h"
+#include "bvh.h"
+#include "trianglepacket.h"
+#include "objloader.h"
+
+class Object;
+
+/**
+ * Triangles read from an OBJ file, as an indexed mesh, with the BVH and
+ * triangle packets to intersect rays with them. The vertex normals and
+ * texture coordinates of the file, if any, are kept in buffers of their
+ * own and interpolated over the triangles. Before the BVH is built,
+ * duplicate vertices are welded and triangles that can't be hit are
+ * dropped. The mesh is centered on the origin and fits
+ * in a sphere of the size it was loaded with; Model places it in the
+ * scene. Meshes are shared by all models that use the same file and
+ * size, see MeshCache. Every user holds a reference, and the mesh is
+ * deleted once the last one is released.
+ */
+class Mesh
+{
+public:
+	Mesh(const std::string &filename, double size);
+
+	void acquire() { refs++; }
+	void release() { if (--refs == 0) delete this; }
+
+	/**
+	 * Intersect a ray with the triangles
+	 * @param obj Object the hit is reported for
+	 */
+	Hit intersect(const Ray &ray, bool closest, double maxT, Object *obj) const;
+	
+	/**
+	 * Interpolate the vertex normals at a point on a triangle
+	 * @param triangle, beta, gamma The point, as found by intersect()
+	 * @param N The normal is written here, in the mesh's own space
+	 * @return False if the triangle has no vertex normals
+	 */
+	bool getNormal(unsigned int triangle, double beta, double gamma, Vector *N) const;
+	// Like getNormal(), for the texture coordinates
+	bool getTexCoords(unsigned int triangle, double beta, double gamma, double *u, double *v) const;
+	/**
+	 * Get how points on a triangle move with their texture coordinates
+	 * @return False if the triangle has no texture coordinates, or they
+	 *         don't span an area of the texture
+	 */
+	bool getTexDerivatives(unsigned int triangle, Vector *dpdu, Vector *dpdv) const;
+
+	// Box around the triangles, in the mesh's own space
+	AABB getBounds() const { return bvh.getBounds(); }
+	unsigned int getNumTriangles() const { return indices.size()/3; }
+	// Bytes used by the triangles and the structures to intersect them
+	size_t getMemorySize() const;
+
+private:
+	int refs;
+	std::vector<Point> positions;
+	std::vector<Vector> normals;
+	std::vector<TexCoord> texCoords;
+	// Three per triangle, into positions, normals and texCoords, see
+	// ObjLoader. The triangles are stored in the order the BVH's leaves
+	// refer to them.
+	std::vector<unsigned int> indices, normalIndices, texCoordIndices;
+	BVH bvh;
+	// The triangles of every BVH leaf, packed for TrianglePacket::intersect().
+	// The packets of the leaf starting at triangle i start at leafPackets[i].
+	std::vector<TrianglePacket> packets;
+	std::vector<unsigned int> leafPackets;
+
+	~Mesh() { }
+
+	const Point &vertex(unsigned int triangle, int corner) const { return positions[indices[triangle*3 + corner]]; }
+	void unitize(double size);
+	// Clean up the triangles before building the BVH, see preprocess()
+	void preprocess(const std::string &filename);
+	unsigned int weld(double epsilon);
+	unsigned int removeDegenerates(double epsilon);
+	unsigned int orderVertices();
+	void reorder(std::vector<unsigned int> *corners) const;
+	void buildBVH(const std::string &filename);
+};
+
+/**
+ * All meshes used by the scene, by file and size, so every file is only
+ * read and stored once no matter how many models use it.
+ */
+class MeshCache
+{
+public:
+	/**
+	 * Get the mesh for a file, reading it if it hasn't been read yet.
+	 * @return Mesh holding a reference for the caller, which it has to release
+	 */
+	static Mesh *get(const std::string &filename, double size);
+
+private:
+	// The cache holds a reference to every mesh, so they can be reused
+	typedef std::map<std::pair<std::string, double>, Mesh*> Map;
+	static Map meshes;
+};
+
+#endif /* end of include guard: MESH_H */
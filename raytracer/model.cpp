@@ -18,57 +18,47 @@
 
 #include "model.h"
 #include "sphere.h"
-#include "triangle.h"
-#include "glm.h"
 
 void Model::init(const std::string& filename, const Vector &rot, double angle)
 {
-	GLMmodel *model = glmReadOBJ((char *)filename.c_str());
-	glmUnitize(model);
-	
-	// We want to use a bounding sphere instead of a bounding cube,
-	// which is what glmUnitize does; therefore, scale down with sqrt(2)
-	glmScale(model, (GLfloat)size/1.5);
-	
-	unsigned int cnt = 0;
-	double *arr = glmModelDoubleArray(model, &cnt);
-	
-	triangles.reserve(cnt);
-	for (unsigned int i=0; i<cnt; i++)
-	{
-		Triangle *tri = new Triangle(
-			Point(arr[i*9+0], arr[i*9+1], arr[i*9+2]) + position,
-			Point(arr[i*9+3], arr[i*9+4], arr[i*9+5]) + position,
-			Point(arr[i*9+6], arr[i*9+7], arr[i*9+8]) + position
-		);
-		triangles.push_back(tri);
-	}
-	
-	free(arr);
-	
+	mesh = MeshCache::get(filename, size);
 	boundingSphere = new Sphere(position, size, rot, angle);
+	// The mesh is centered on the origin of the model's own space
+	setTransform(Transform(rotation, position));
 }
 
 Hit Model::intersect(const Ray &ray, bool closest, double maxT)
-{	
-	// First check the bounding sphere
-	Hit bounding_hit = boundingSphere->intersect(ray, closest, maxT);
-	if (!bounding_hit.hasHit()) return Hit::NO_HIT();
-	
-	// Find hit object and distance
-	Hit min_hit = Hit::NO_HIT();
-	
-	for (unsigned int i = 0; i < triangles.size(); ++i) {
-		Hit hit = triangles[i]->intersect(ray, closest, maxT);
-		if (hit.hasHit() && (hit.t < min_hit.t || !min_hit.hasHit()) && hit.t < maxT) {
-			min_hit = hit;
-			if (!closest)
-				break;
-		}
+{
+	// Find hit object and distance. The transform only rotates and moves,
+	// so t is the same in both spaces. Rays that miss the mesh's box in
+	// the model's own space, which fits the mesh tighter than any box or
+	// sphere in world space, are rejected by the mesh's BVH right away.
+	Ray r(getWorldToObject().apply(ray.O), getWorldToObject().applyDirection(ray.D));
+	Hit hit = mesh->intersect(r, closest, maxT, this);
+	hit.N = getObjectToWorld().applyDirection(hit.N);
+	return hit;
+}
+
+Vector Model::getShadingNormal(const Hit &hit)
+{
+	Vector N;
+	if (!mesh->getNormal(hit.triangle, hit.beta, hit.gamma, &N))
+		return hit.N;
+	return getObjectToWorld().applyDirection(N);
+}
+
+void Model::getHitTexCoords(const Hit &hit, SurfaceInteraction *si)
+{
+	// Meshes without texture coordinates are mapped like the bounding sphere
+	if (!mesh->getTexCoords(hit.triangle, hit.beta, hit.gamma, &si->u, &si->v)) {
+		Object::getHitTexCoords(hit, si);
+		return;
+	}
+	si->hasDerivatives = mesh->getTexDerivatives(hit.triangle, &si->dpdu, &si->dpdv);
+	if (si->hasDerivatives) {
+		si->dpdu = getObjectToWorld().applyDirection(si->dpdu);
+		si->dpdv = getObjectToWorld().applyDirection(si->dpdv);
 	}
-	
-	min_hit.makeObj(this);
-	return min_hit;
 }
 
 void Model::getTexCoords(const Point &p, double &u, double &v)
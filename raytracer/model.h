@@ -20,11 +20,15 @@
 #define MODEL_H
 
 #include <string>
-#include <vector>
 #include "object.h"
 #include "sphere.h"
-#include "triangle.h"
+#include "mesh.h"
 
+/**
+ * A mesh from an OBJ file, placed in the scene at a position and
+ * rotation. The triangles are stored once per file and size, and shared
+ * by all models that use them, see MeshCache.
+ */
 class Model : public Object
 {
 public:
@@ -37,21 +41,29 @@ public:
 	virtual ~Model()
 	{
 		delete boundingSphere;
+		mesh->release();
 	}
 		
-	std::vector<Triangle*> triangles;
 	Sphere * boundingSphere;
 
 	virtual Hit intersect(const Ray &ray, bool closest, double maxT);
 	virtual Point getRotationCenter() { return position; }
 	virtual void getTexCoords(const Point &p, double &x, double &y);
+	// The normals and texture coordinates of the mesh, if it has them
+	virtual Vector getShadingNormal(const Hit &hit);
+	virtual void getHitTexCoords(const Hit &hit, SurfaceInteraction *si);
+	// The box around the mesh in the model's own space, placed in the scene
+	virtual AABB getBounds() { return mesh->getBounds().transformed(getObjectToWorld()); }
 
 	const Point position;
 	const double size;
 	
 	double getRadius() { return boundingSphere->getRadius(); };
+	unsigned int getNumTriangles() const { return mesh->getNumTriangles(); }
 	
 private:
+	Mesh *mesh;
+	
 	void init(const std::string& filename, const Vector &rot, double angle);
 };
 
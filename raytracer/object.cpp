@@ -17,95 +17,156 @@
 #include "object.h"
 #include "material.h"
 
-Point Object::rotate(const Point &p)
+void Object::getSpans(const Ray &ray, SpanList *spans)
 {
-	/* We need to:
-	 * 1) translate the rotation center to the origin
-	 * 2) rotate rAngle degrees around rVec
-	 * 3) translate back (undo #1)
-	 */
-	Point c = getRotationCenter();
-	return r*(p - c) + c;
+	static const double inf = std::numeric_limits<double>::infinity();
+	Span span;
+	bool inside = false;
+	Ray r = ray;
+	double offset = 0.0; // t of r.O on the original ray
+	for (int i = 0; i < OBJECT_MAX_CROSSINGS; i++) {
+		Hit hit = intersect(r, true, inf);
+		if (!hit.hasHit())
+			break;
+		
+		// Look for the next crossing from just past this one
+		hit.t += offset;
+		offset = hit.t + 0.01;
+		r = Ray(ray.at(offset), ray.D);
+		
+		hit.entering = !inside;
+		if (inside) {
+			span.out = hit;
+			spans->push_back(span);
+		} else {
+			span.in = hit;
+		}
+		inside = !inside;
+	}
+	
+	if (inside) {
+		span.out = Hit(inf, Vector(0, 0, 0), span.in.obj);
+		spans->push_back(span);
+	}
+}
+
+void Object::getSurfaceInteraction(const Hit &hit, const Ray &ray, double width, SurfaceInteraction *si)
+{
+	si->obj = this;
+	si->p = ray.at(hit.t);
+	si->Ng = hit.N;
+	si->N = getShadingNormal(hit);
+	si->entering = hit.entering;
+	
+	// Only look up texture coordinates if some map needs them
+	si->hasTexCoords = texture || specularTexture || bumpmap || darkmap || photonblurmap;
+	si->hasDerivatives = false;
+	if (si->hasTexCoords)
+	{
+		getHitTexCoords(hit, si);
+	}
+	
+	// Part of the textures this sample covers
+	bool filtered = texture || specularTexture || bumpmap || darkmap;
+	if (filtered && width > 0.0)
+		getTexFootprint(*si, width, &si->fp);
+	else
+		si->fp = TexFootprint();
+	
+	si->N = getBumpedNormal(*si);
 }
 
-Point Object::unRotate(const Point &p)
+void Object::getHitTexCoords(const Hit &hit, SurfaceInteraction *si)
 {
-	Point c = getRotationCenter();
-	return rInv*(p - c) + c;
+	getTexCoords(si->p, si->u, si->v);
+	si->hasDerivatives = getTexDerivatives(si->p, si->u, si->v, &si->dpdu, &si->dpdv);
 }
 
-Color Object::getColor(const Point &p)
+Color Object::getColor(const SurfaceInteraction &si)
 {	
 	if (!texture || texture->size() == 0)
 		// No texture, use material
 		return material->color;
 	
-	double u, v;
-	getTexCoords(p, u, v);
-	
-	// u and v are in [0,1] so scale them to the texture dimensions
-	return texture->colorAt(u, v);
+	return texture->colorAt(si.u, si.v, si.fp);
 }
 
-Color Object::getPhotons(const Point &p)
+Color Object::getPhotons(const SurfaceInteraction &si)
 {
-	if (!photonmap && !photonblurmap) return Color(0,0,0);
-	
-	double u, v;
-	getTexCoords(p, u, v);
-	
 	if (photonblurmap)
-		return photonblurmap->colorAt(u, v);
+		return photonblurmap->colorAt(si.u, si.v);
 	else
-		return photonmap->colorAt(u, v);
+		return Color(0,0,0);
 }
 
-double Object::getKs(const Point &p)
+double Object::getKs(const SurfaceInteraction &si)
 {
 	if (!specularTexture || specularTexture->size() == 0)
 		// No texture, use material
 		return material->ks;
 	
-	double u, v;
-	getTexCoords(p, u, v);
 	// Use the red channel of the texture image, ignore the green and blue channels
-	return material->ks*specularTexture->colorAt(u, v).r;
+	return material->ks*specularTexture->colorAt(si.u, si.v, si.fp).r;
 }
 
-Vector Object::getBumpedNormal(const Vector &origNormal, const Point &p)
+Vector Object::getBumpedNormal(const SurfaceInteraction &si)
 {
 	if (!bumpmap || bumpmap->size() == 0)
 		// No bump map, don't mess with normal
-		return origNormal;
+		return si.N;
 	
-	double u, v;
 	float dx, dy;
-	getTexCoords(p, u, v);
-	bumpmap->derivativeAt(u, v, &dx, &dy);
+	bumpmap->derivativeAt(si.u, si.v, si.fp, &dx, &dy);
 	
 	// Get the vectors to (u,v) from the points corresponding to the texture pixels
 	// immediately right and down from it
-	Vector dxVec = p - getPointFromTexCoords(min(u+1.0/(bumpmap->width()-1), 1.0), v);
-	Vector dyVec = p - getPointFromTexCoords(u, min(v+1.0/(bumpmap->height()-1), 1.0));
+	Vector dxVec, dyVec;
+	if (si.hasDerivatives)
+	{
+		dxVec = -si.dpdu/(double)(bumpmap->width()-1);
+		dyVec = -si.dpdv/(double)(bumpmap->height()-1);
+	}
+	else
+	{
+		dxVec = si.p - getPointFromTexCoords(min(si.u+1.0/(bumpmap->width()-1), 1.0), si.v);
+		dyVec = si.p - getPointFromTexCoords(si.u, min(si.v+1.0/(bumpmap->height()-1), 1.0));
+	}
 
-	return (origNormal + bumpfactor*(dx*dxVec + dy*dyVec)).normalized();
+	return (si.N + bumpfactor*(dx*dxVec + dy*dyVec)).normalized();
 }
 
-void Object::addPhoton(const Point &p, Color &color)
+void Object::getTexFootprint(const SurfaceInteraction &si, double width, TexFootprint *fp)
 {
-	if (photonmap)
+	// Texture coordinates wrap around, so they can't move more than half
+	if (si.hasDerivatives)
+	{
+		fp->du = min(width/si.dpdu.length(), 0.5);
+		fp->dv = min(width/si.dpdv.length(), 0.5);
+		return;
+	}
+	
+	fp->du = fp->dv = 0.0;
+	
+	// Step width along two directions in the surface and see how far the
+	// texture coordinates move
+	const Vector &N = si.Ng;
+	Vector a = N.cross(fabs(N.x) > 0.5 ? Vector(0, 1, 0) : Vector(1, 0, 0)).normalized();
+	Vector b = N.cross(a);
+	double u1, v1;
+	for (int i = 0; i < 2; i++)
 	{
-		double u, v;
-		getTexCoords(p, u, v);
-		Color newColor = color + photonmap->colorAt(u, v);
-		newColor.clamp();
-		photonmap->setColorAt(u, v, newColor);
+		getTexCoords(si.p + width*(i == 0 ? a : b), u1, v1);
+		double du = fabs(u1 - si.u), dv = fabs(v1 - si.v);
+		// Texture coordinates wrap around, e.g. at the seam of a sphere
+		if (du > 0.5) du = 1.0 - du;
+		if (dv > 0.5) dv = 1.0 - dv;
+		fp->du = max(fp->du, du);
+		fp->dv = max(fp->dv, dv);
 	}
 }
 
-void Object::blurPhotonMap(int radius)
+void Object::blurPhotonMap(Image *photonmap, int radius)
 {
 	photonblurmap = new Image(photonmap->width(), photonmap->height());
 	photonmap->blur(photonblurmap, radius);
-	delete photonmap;
 }
\ No newline at end of file
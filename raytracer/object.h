@@ -21,48 +21,57 @@
 
 #include "triple.h"
 #include "image.h"
+#include "texture.h"
 #include "matrix.h"
+#include "transform.h"
 #include "material.h"
 #include "hit.h"
+#include "surfaceinteraction.h"
 #include "ray.h"
+#include "aabb.h"
 #include <vector>
 
+// Most surface crossings Object::getSpans() looks for
+#define OBJECT_MAX_CROSSINGS 64
+
 class Object {
 public:
 	Material *material;
-	Image *texture, *specularTexture, *bumpmap, *photonmap, *photonblurmap, *darkmap;
+	Texture *texture, *specularTexture, *bumpmap, *darkmap;
+	Image *photonblurmap;
+	// Size of the texture RenderMode photon bakes the photons into, 0 for none
+	int photonmapSize;
 	double bumpfactor;
+	bool receivesPhotons; // whether photons are stored where they hit this object
 	
 	Object(const Vector &rotationVector, double rotationAngle) :
-		r(Matrix::rotationDeg(rotationVector, rotationAngle)),
-		rInv(Matrix::rotationDeg(rotationVector, -rotationAngle))
+		rotation(Matrix::rotationDeg(rotationVector, rotationAngle))
 	{
 		material = NULL;
 		texture = NULL;
 		specularTexture = NULL;
 		bumpmap = NULL;
-		photonmap = NULL;
 		photonblurmap = NULL;
+		photonmapSize = 0;
 		darkmap = NULL;
 		bumpfactor = 1.0;
+		receivesPhotons = false;
 	}
 
 	virtual ~Object()
 	{
 		if (texture)
-			delete texture;
+			texture->release();
 		if (specularTexture)
-			delete specularTexture;
+			specularTexture->release();
 		if (bumpmap)
-			delete bumpmap;
+			bumpmap->release();
 		if (material)
 			delete material;
-		if (photonmap)
-			delete photonmap;
 		if (photonblurmap)
 			delete photonblurmap;
 		if (darkmap)
-			delete darkmap;
+			darkmap->release();
 	}
 	
 	/**
@@ -74,23 +83,92 @@ public:
 	 */
 	virtual Hit intersect(const Ray &ray, bool closest, double maxT) = 0;
 	
+	/**
+	 * Find all parts of a ray that are inside the object, for CSG.
+	 * The default finds the surface crossings one at a time with
+	 * intersect(), and assumes they alternately take the ray in and out,
+	 * starting outside at the ray's origin.
+	 * @param ray Ray to intersect with
+	 * @param spans The spans are appended here, sorted by t
+	 */
+	virtual void getSpans(const Ray &ray, SpanList *spans);
+	
 	virtual Point getRotationCenter() = 0;
 	// TODO: Implement these three in Triangle and Quad and make them pure virtual
 	virtual void getTexCoords(const Point &p, double &u, double &v) { u = 0; v = 0; }
 	virtual Point getPointFromTexCoords(double u, double v) { return Point(0, 0, 0); }
 	virtual double getRadius() { return 0.0; }
 	
-	Point rotate(const Point &p);
-	Point unRotate(const Point &p);
-	Color getColor(const Point &p);
-	Color getPhotons(const Point &p);
-	double getKs(const Point &p);
-	Vector getBumpedNormal(const Vector &origNormal, const Point &p);
-	void addPhoton(const Point &p, Color &color);
-	void blurPhotonMap(int radius);
+	/**
+	 * Get how a point on the surface moves when its texture coordinates change.
+	 * @return False if the object can't tell. Bump mapping then falls back to
+	 *         getPointFromTexCoords(), and texture filtering to getTexCoords().
+	 */
+	virtual bool getTexDerivatives(const Point &p, double u, double v, Vector *dpdu, Vector *dpdv) { return false; }
+	
+	/**
+	 * Get the normal to shade a hit with, before bump mapping. Objects
+	 * that approximate a smooth surface (models) interpolate it.
+	 */
+	virtual Vector getShadingNormal(const Hit &hit) { return hit.N; }
+	/**
+	 * Fill in the texture coordinates of a hit (si->u and si->v), and how
+	 * the surface moves with them if the object can tell. Unless the
+	 * object can tell more from the hit, they follow from the hit point,
+	 * see getTexCoords() and getTexDerivatives().
+	 */
+	virtual void getHitTexCoords(const Hit &hit, SurfaceInteraction *si);
+	
+	/**
+	 * Get a box that contains every point where intersect() can report a hit.
+	 * Objects that don't override this are treated as unbounded.
+	 */
+	virtual AABB getBounds() { return AABB::infinite(); }
+	
+	// Transforms between world space and the object's own space, see setTransform()
+	const Transform &getObjectToWorld() const { return objectToWorld; }
+	const Transform &getWorldToObject() const { return worldToObject; }
+	
+	/**
+	 * Gather what shading needs to know about a hit on this object.
+	 * @param hit Hit on this object
+	 * @param ray Ray that found the hit
+	 * @param width Width of the area the sample covers around the hit point,
+	 *              to filter textures with. Zero for a single point.
+	 * @param si The record is written here
+	 */
+	void getSurfaceInteraction(const Hit &hit, const Ray &ray, double width, SurfaceInteraction *si);
+	Color getColor(const SurfaceInteraction &si);
+	Color getPhotons(const SurfaceInteraction &si);
+	double getKs(const SurfaceInteraction &si);
+	// Blur a baked photon map into photonblurmap
+	void blurPhotonMap(Image *photonmap, int radius);
+
+protected:
+	Matrix rotation; // rotation from the scene file
+	
+	/**
+	 * Rotate a point around a center by the object's rotation, for
+	 * constructors that build the rotation into their geometry
+	 */
+	Point rotate(const Point &p, const Point &center) const { return center + rotation*(p - center); }
+	Point rotate(const Point &p) { return rotate(p, getRotationCenter()); }
+	
+	/**
+	 * Set the object's own space, in which it may have a simpler shape
+	 * (a unit sphere, a cylinder along the x axis). Constructors call this
+	 * once, so rays and points can be moved into that space without any
+	 * further setup. Without it the object's own space is world space.
+	 * @param toWorld Transform from the object's own space to world space
+	 */
+	void setTransform(const Transform &toWorld) { objectToWorld = toWorld; worldToObject = toWorld.inverse(); }
 
 private:
-	Matrix r, rInv; // rotation matrices
+	Transform objectToWorld, worldToObject;
+	
+	Vector getBumpedNormal(const SurfaceInteraction &si);
+	// Estimate the texture coordinates covered by a sample of the given width
+	void getTexFootprint(const SurfaceInteraction &si, double width, TexFootprint *fp);
 };
 
 #endif /* end of include guard: OBJECT_H_AXKLE0OF */
@@ -0,0 +1,355 @@
+//
+//  Framework for a raytracer
+//  File: objloader.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "objloader.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <omp.h>
+
+// Files smaller than this are read by one thread
+#define OBJ_MIN_CHUNK_SIZE 65536
+
+// The kinds of vertex data a face refers to, in the order of the file
+enum { POSITION, TEXCOORD, NORMAL, NUM_ATTRIBUTES };
+
+// Reference from a face to vertex data it doesn't have
+#define OBJ_NO_REF INT_MIN
+
+// What is read from one part of the file
+struct ObjLoader::Chunk
+{
+	std::vector<Point> positions;
+	std::vector<Vector> normals;
+	std::vector<TexCoord> texCoords;
+	// The vertex data of the triangles, three per triangle, per attribute.
+	// References that count back from the last vertex read (negative ones
+	// in the file) are stored relative to the first vertex of the chunk,
+	// and their places in refs are listed in relative. The others are
+	// stored 0-based.
+	std::vector<int> refs[NUM_ATTRIBUTES];
+	std::vector<unsigned int> relative[NUM_ATTRIBUTES];
+	bool ok;
+
+	unsigned int count(int attribute) const
+	{
+		switch (attribute) {
+			case POSITION: return positions.size();
+			case TEXCOORD: return texCoords.size();
+			default: return normals.size();
+		}
+	}
+};
+
+static inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char *skipBlanks(const char *p, const char *end)
+{
+	while (p < end && isBlank(*p))
+		p++;
+	return p;
+}
+
+static inline const char *nextLine(const char *p, const char *end)
+{
+	const char *eol = (const char *)memchr(p, '\n', end - p);
+	return eol ? eol + 1 : end;
+}
+
+static const char *parseInt(const char *p, const char *end, int *value)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	if (p == end || !isDigit(*p))
+		return NULL;
+	int v = 0;
+	for (; p < end && isDigit(*p); p++)
+		v = v*10 + (*p - '0');
+	*value = negative ? -v : v;
+	return p;
+}
+
+/**
+ * Parse a decimal number. Numbers with up to 15 significant digits and a
+ * small exponent, which is what OBJ files are made of, are converted
+ * exactly with one multiplication or division. Anything else is left to
+ * strtod().
+ * @return The end of the number, or NULL if there is no number at p
+ */
+static const char *parseDouble(const char *p, const char *end, double *value)
+{
+	// Powers of ten that doubles represent exactly
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const char *start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	unsigned long long mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool any = false;
+	for (; p < end && isDigit(*p); p++) {
+		any = true;
+		if (digits < 19) {
+			mantissa = mantissa*10 + (*p - '0');
+			if (mantissa) digits++;
+		} else {
+			exponent++;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && isDigit(*p); p++) {
+			any = true;
+			if (digits < 19) {
+				mantissa = mantissa*10 + (*p - '0');
+				if (mantissa) digits++;
+				exponent--;
+			}
+		}
+	}
+	if (!any)
+		return NULL;
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		int e;
+		const char *q = parseInt(p + 1, end, &e);
+		if (q) {
+			exponent += e;
+			p = q;
+		}
+	}
+
+	if (mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+		double v = exponent < 0 ? mantissa/powers[-exponent] : mantissa*powers[exponent];
+		*value = negative ? -v : v;
+	} else {
+		std::string s(start, p);
+		*value = strtod(s.c_str(), NULL);
+	}
+	return p;
+}
+
+// Read up to n numbers separated by blanks
+static const char *parseDoubles(const char *p, const char *end, int n, double *values)
+{
+	for (int i = 0; i < n && p; i++)
+		p = parseDouble(skipBlanks(p, end), end, &values[i]);
+	return p;
+}
+
+void ObjLoader::parse(const char *p, const char *end, Chunk *chunk)
+{
+	chunk->ok = true;
+	// The corners of the current face: a reference per attribute, and
+	// whether it is relative
+	std::vector<int> face[NUM_ATTRIBUTES];
+	std::vector<bool> faceRelative[NUM_ATTRIBUTES];
+
+	for (; p < end; p = nextLine(p, end)) {
+		p = skipBlanks(p, end);
+		if (end - p < 2)
+			continue;
+
+		const char *q = NULL;
+		if (p[0] == 'v' && isBlank(p[1])) {
+			Point v;
+			if ((q = parseDoubles(p + 1, end, 3, v.data)))
+				chunk->positions.push_back(v);
+		} else if (p[0] == 'v' && p[1] == 'n') {
+			Vector n;
+			if ((q = parseDoubles(p + 2, end, 3, n.data)))
+				chunk->normals.push_back(n);
+		} else if (p[0] == 'v' && p[1] == 't') {
+			// The third coordinate of 3D textures is ignored
+			double uv[2];
+			if ((q = parseDoubles(p + 2, end, 2, uv)))
+				chunk->texCoords.push_back(TexCoord(uv[0], uv[1]));
+		} else if (p[0] == 'f' && isBlank(p[1])) {
+			for (int a = 0; a < NUM_ATTRIBUTES; a++) {
+				face[a].clear();
+				faceRelative[a].clear();
+			}
+			q = skipBlanks(p + 1, end);
+			while (q && q < end && *q != '\n') {
+				// v, v/vt, v//vn or v/vt/vn
+				int refs[NUM_ATTRIBUTES] = { OBJ_NO_REF, OBJ_NO_REF, OBJ_NO_REF };
+				q = parseInt(q, end, &refs[POSITION]);
+				for (int a = TEXCOORD; a < NUM_ATTRIBUTES && q && q < end && *q == '/'; a++) {
+					q++;
+					if (q < end && *q != '/' && !isBlank(*q) && *q != '\n')
+						q = parseInt(q, end, &refs[a]);
+				}
+				if (!q || refs[POSITION] == OBJ_NO_REF)
+					break;
+				q = skipBlanks(q, end);
+
+				for (int a = 0; a < NUM_ATTRIBUTES; a++) {
+					int v = refs[a];
+					if (v == 0) {
+						q = NULL;
+						break;
+					}
+					if (v < 0 && v != OBJ_NO_REF)
+						v += chunk->count(a);
+					else if (v > 0)
+						v--;
+					face[a].push_back(v);
+					faceRelative[a].push_back(refs[a] < 0 && refs[a] != OBJ_NO_REF);
+				}
+			}
+
+			// Split the polygon into a fan of triangles around its first vertex
+			for (unsigned int i = 2; q && i < face[POSITION].size(); i++) {
+				unsigned int corners[3] = { 0, i - 1, i };
+				for (int a = 0; a < NUM_ATTRIBUTES; a++) {
+					for (int j = 0; j < 3; j++) {
+						if (faceRelative[a][corners[j]])
+							chunk->relative[a].push_back(chunk->refs[a].size());
+						chunk->refs[a].push_back(face[a][corners[j]]);
+					}
+				}
+			}
+		} else {
+			continue;
+		}
+
+		if (!q) {
+			chunk->ok = false;
+			return;
+		}
+	}
+}
+
+bool ObjLoader::load(const std::string &filename)
+{
+	positions.clear();
+	normals.clear();
+	texCoords.clear();
+	indices.clear();
+	normalIndices.clear();
+	texCoordIndices.clear();
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "Error: unable to open model %s.\n", filename.c_str());
+		if (fd >= 0) close(fd);
+		return false;
+	}
+	size_t size = st.st_size;
+	if (size == 0) {
+		close(fd);
+		return true;
+	}
+	const char *data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Error: unable to read model %s.\n", filename.c_str());
+		return false;
+	}
+	madvise((void *)data, size, MADV_SEQUENTIAL);
+	const char *end = data + size;
+
+	// Cut the file into a few chunks per thread, at the start of a line
+	int numChunks = 1;
+	if (size >= OBJ_MIN_CHUNK_SIZE)
+		numChunks = std::min((int)(size/OBJ_MIN_CHUNK_SIZE), 4*omp_get_max_threads());
+	std::vector<const char *> starts(numChunks + 1);
+	starts[0] = data;
+	starts[numChunks] = end;
+	for (int i = 1; i < numChunks; i++)
+		starts[i] = nextLine(data + size*i/numChunks - 1, end);
+
+	std::vector<Chunk> chunks(numChunks);
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < numChunks; i++) {
+		if (starts[i] < starts[i + 1])
+			parse(starts[i], starts[i + 1], &chunks[i]);
+		else
+			chunks[i].ok = true;
+	}
+	munmap((void *)data, size);
+
+	// Where every chunk goes in the whole mesh
+	std::vector<unsigned int> first[NUM_ATTRIBUTES], firstRef(numChunks + 1, 0);
+	for (int a = 0; a < NUM_ATTRIBUTES; a++)
+		first[a].assign(numChunks + 1, 0);
+	for (int i = 0; i < numChunks; i++) {
+		if (!chunks[i].ok) {
+			fprintf(stderr, "Error: unable to parse model %s.\n", filename.c_str());
+			return false;
+		}
+		for (int a = 0; a < NUM_ATTRIBUTES; a++)
+			first[a][i + 1] = first[a][i] + chunks[i].count(a);
+		firstRef[i + 1] = firstRef[i] + chunks[i].refs[POSITION].size();
+	}
+
+	positions.resize(first[POSITION][numChunks]);
+	normals.resize(first[NORMAL][numChunks]);
+	texCoords.resize(first[TEXCOORD][numChunks]);
+	std::vector<unsigned int> *attributeIndices[NUM_ATTRIBUTES] = { &indices, &texCoordIndices, &normalIndices };
+	for (int a = 0; a < NUM_ATTRIBUTES; a++)
+		attributeIndices[a]->resize(firstRef[numChunks]);
+	bool valid = true, hasNormals = false, hasTexCoords = false;
+	#pragma omp parallel for schedule(dynamic) reduction(&&:valid) reduction(||:hasNormals, hasTexCoords)
+	for (int i = 0; i < numChunks; i++) {
+		Chunk &chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + first[POSITION][i]);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + first[NORMAL][i]);
+		std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + first[TEXCOORD][i]);
+		for (int a = 0; a < NUM_ATTRIBUTES; a++) {
+			std::vector<int> &refs = chunk.refs[a];
+			for (unsigned int j = 0; j < chunk.relative[a].size(); j++)
+				refs[chunk.relative[a][j]] += first[a][i];
+			unsigned int *out = &(*attributeIndices[a])[firstRef[i]];
+			int count = first[a][numChunks];
+			for (unsigned int j = 0; j < refs.size(); j++) {
+				int ref = refs[j];
+				if (ref == OBJ_NO_REF && a != POSITION) {
+					out[j] = NO_INDEX;
+					continue;
+				}
+				if (ref < 0 || ref >= count) {
+					valid = false;
+					ref = 0;
+				}
+				out[j] = ref;
+				if (a == NORMAL) hasNormals = true;
+				if (a == TEXCOORD) hasTexCoords = true;
+			}
+			std::vector<int>().swap(refs);
+		}
+	}
+	if (!valid) {
+		fprintf(stderr, "Error: model %s refers to vertices it doesn't have.\n", filename.c_str());
+		return false;
+	}
+	if (!hasNormals)
+		std::vector<unsigned int>().swap(normalIndices);
+	if (!hasTexCoords)
+		std::vector<unsigned int>().swap(texCoordIndices);
+	return true;
+}
@@ -0,0 +1,67 @@
+//
+//  Framework for a raytracer
+//  File: objloader.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include <string>
+#include <vector>
+#include "triple.h"
+
+// Texture coordinates of a vertex
+struct TexCoord
+{
+	double u, v;
+	TexCoord() : u(0), v(0) { }
+	TexCoord(double u, double v) : u(u), v(v) { }
+};
+
+/**
+ * Reads the geometry of a Wavefront OBJ file into an indexed triangle
+ * mesh. The file is mapped into memory and cut into chunks at line
+ * boundaries, which are parsed in parallel and then joined in file order,
+ * so the result doesn't depend on the number of threads. Polygons are
+ * split into fans of triangles, the same way glm does it. Vertex
+ * positions, normals, texture coordinates and faces are read; materials,
+ * groups and everything else are skipped.
+ */
+class ObjLoader
+{
+public:
+	/**
+	 * Read a file into the buffers below, replacing what they held.
+	 * @return False if the file can't be read or refers to vertices it
+	 *         doesn't have. An error has been printed then.
+	 */
+	bool load(const std::string &filename);
+
+	// Index of a triangle corner without a normal or texture coordinates
+	static const unsigned int NO_INDEX = ~0u;
+
+	std::vector<Point> positions;
+	std::vector<Vector> normals;
+	std::vector<TexCoord> texCoords;
+	// Three per triangle, into positions, normals and texCoords. The
+	// last two are left empty if no face refers to any normal or texture
+	// coordinates.
+	std::vector<unsigned int> indices, normalIndices, texCoordIndices;
+
+private:
+	struct Chunk;
+	static void parse(const char *p, const char *end, Chunk *chunk);
+};
+
+#endif /* end of include guard: OBJLOADER_H */
@@ -0,0 +1,145 @@
+//
+//  Framework for a raytracer
+//  File: occlusioncache.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "occlusioncache.h"
+#include <math.h>
+
+void OcclusionCache::clear(double maxError)
+{
+	this->maxError = maxError;
+	samples.clear();
+	nodes.clear();
+	root = NO_NODE;
+}
+
+unsigned int OcclusionCache::addNode(const Point &center, double halfSize)
+{
+	Node node;
+	node.center = center;
+	node.halfSize = halfSize;
+	for (int i = 0; i < 8; i++)
+		node.children[i] = NO_NODE;
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+bool OcclusionCache::contains(const Node &node, const Point &p)
+{
+	return fabs(p.x - node.center.x) <= node.halfSize && fabs(p.y - node.center.y) <= node.halfSize &&
+		fabs(p.z - node.center.z) <= node.halfSize;
+}
+
+int OcclusionCache::octant(const Node &node, const Point &p)
+{
+	return (p.x >= node.center.x ? 1 : 0) | (p.y >= node.center.y ? 2 : 0) | (p.z >= node.center.z ? 4 : 0);
+}
+
+void OcclusionCache::grow(const Point &p)
+{
+	// The old root becomes the child of a node twice its size, which
+	// extends towards p
+	Point center = nodes[root].center;
+	double halfSize = nodes[root].halfSize;
+	for (int i = 0; i < 3; i++)
+		center.data[i] += p.data[i] >= center.data[i] ? halfSize : -halfSize;
+	unsigned int newRoot = addNode(center, 2*halfSize);
+	nodes[newRoot].children[octant(nodes[newRoot], nodes[root].center)] = root;
+	root = newRoot;
+}
+
+void OcclusionCache::add(const Point &p, const Vector &N, double radius, double occlusion)
+{
+	Sample sample;
+	sample.p = p;
+	sample.N = N;
+	sample.radius = radius;
+	sample.occlusion = occlusion;
+	samples.push_back(sample);
+
+	// Points further away than this can't use the sample, see lookup()
+	double reach = maxError*radius;
+	Point min = p - reach, max = p + reach;
+	if (root == NO_NODE)
+		root = addNode(p, reach);
+	while (nodes[root].halfSize < reach || !contains(nodes[root], min) || !contains(nodes[root], max))
+		grow(p);
+	add(root, min, max, reach, samples.size() - 1);
+}
+
+void OcclusionCache::add(unsigned int node, const Point &min, const Point &max, double reach, unsigned int sample)
+{
+	// The sample goes into every node of about its size that its sphere
+	// overlaps, so lookups only have to search the nodes around the point
+	double halfSize = nodes[node].halfSize;
+	if (halfSize < reach)
+	{
+		nodes[node].samples.push_back(sample);
+		return;
+	}
+
+	double h = halfSize/2;
+	for (int i = 0; i < 8; i++)
+	{
+		Point center = nodes[node].center + Vector(i & 1 ? h : -h, i & 2 ? h : -h, i & 4 ? h : -h);
+		if (min.x > center.x + h || max.x < center.x - h ||
+			min.y > center.y + h || max.y < center.y - h ||
+			min.z > center.z + h || max.z < center.z - h)
+			continue;
+		if (nodes[node].children[i] == NO_NODE)
+		{
+			unsigned int child = addNode(center, h);
+			nodes[node].children[i] = child;
+		}
+		add(nodes[node].children[i], min, max, reach, sample);
+	}
+}
+
+void OcclusionCache::merge(OcclusionCache *other)
+{
+	for (unsigned int i = 0; i < other->samples.size(); i++)
+	{
+		const Sample &s = other->samples[i];
+		add(s.p, s.N, s.radius, s.occlusion);
+	}
+	other->clear(other->maxError);
+}
+
+void OcclusionCache::lookup(const Point &p, const Vector &N, double *weight, double *occlusion) const
+{
+	if (root == NO_NODE || !contains(nodes[root], p))
+		return;
+
+	for (unsigned int node = root; node != NO_NODE; node = nodes[node].children[octant(nodes[node], p)])
+	{
+		const Node &n = nodes[node];
+		for (unsigned int i = 0; i < n.samples.size(); i++)
+		{
+			const Sample &s = samples[n.samples[i]];
+			Vector d = p - s.p;
+			// Estimate of the error made by using the sample at p, which grows
+			// with the distance and the angle between the normals
+			double error = d.length()/s.radius + sqrt(fmax(0.0, 1.0 - N.dot(s.N)));
+			if (error >= maxError)
+				continue;
+			// Samples in front of p may see blockers that p is behind
+			if (d.dot(N + s.N) < -0.01*s.radius)
+				continue;
+			double w = 1.0/fmax(error, 1e-6);
+			*weight += w;
+			*occlusion += w*s.occlusion;
+		}
+	}
+}
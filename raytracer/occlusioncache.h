@@ -0,0 +1,100 @@
+//
+//  Framework for a raytracer
+//  File: occlusioncache.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef OCCLUSIONCACHE_H
+#define OCCLUSIONCACHE_H
+
+#include <vector>
+#include "triple.h"
+
+/**
+ * Ambient occlusion computed at points in the scene, so points close to
+ * them can interpolate it instead of casting rays of their own (an
+ * irradiance cache, after Ward et al., "A Ray Tracing Solution for
+ * Diffuse Interreflection"). Every sample is valid in a sphere whose
+ * radius follows the distance to the geometry around it: occlusion
+ * changes quickly near other objects and slowly in the open. The samples
+ * are kept in an octree, every one in all nodes of about the size of the
+ * sphere it is valid in that the sphere overlaps. Finding the samples
+ * valid at a point only takes the nodes on the path down to it.
+ *
+ * The cache can be read by many threads at once, but not while samples
+ * are added. Threads add their samples to caches of their own, which are
+ * merged into the shared one between passes.
+ */
+class OcclusionCache
+{
+public:
+	OcclusionCache() : maxError(0.0), root(NO_NODE) { }
+
+	/**
+	 * Remove all samples
+	 * @param maxError How far a point may be from a sample before it can't
+	 *        use it, relative to the sample's radius. Differences between
+	 *        the normals count as well. Smaller values give more accurate
+	 *        results, but more samples.
+	 */
+	void clear(double maxError);
+
+	/**
+	 * Add a sample
+	 * @param radius Harmonic mean of the distances the sample's rays travelled
+	 * @param occlusion Fraction of the rays that weren't blocked
+	 */
+	void add(const Point &p, const Vector &N, double radius, double occlusion);
+	// Add the samples of another cache and clear it
+	void merge(OcclusionCache *other);
+
+	/**
+	 * Add the samples that are valid at a point to a weighted sum
+	 * @param weight, occlusion The weights and the weighted occlusion of
+	 *        the samples found are added to these
+	 */
+	void lookup(const Point &p, const Vector &N, double *weight, double *occlusion) const;
+
+	unsigned int size() const { return samples.size(); }
+
+private:
+	struct Sample
+	{
+		Point p;
+		Vector N;
+		double radius, occlusion;
+	};
+
+	struct Node
+	{
+		Point center;
+		double halfSize;
+		unsigned int children[8];
+		std::vector<unsigned int> samples;
+	};
+
+	static const unsigned int NO_NODE = ~0u;
+
+	double maxError;
+	std::vector<Sample> samples;
+	std::vector<Node> nodes;
+	unsigned int root;
+
+	unsigned int addNode(const Point &center, double halfSize);
+	static bool contains(const Node &node, const Point &p);
+	static int octant(const Node &node, const Point &p);
+	void grow(const Point &p);
+	void add(unsigned int node, const Point &min, const Point &max, double reach, unsigned int sample);
+};
+
+#endif /* end of include guard: OCCLUSIONCACHE_H */
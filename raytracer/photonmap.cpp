@@ -0,0 +1,170 @@
+//
+//  Framework for a raytracer
+//  File: photonmap.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "photonmap.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+Photon::Photon(const Point &p, const Vector &dir, const Color &color)
+{
+	for (int i = 0; i < 3; i++) {
+		position[i] = (float)p.data[i];
+		power[i] = (float)color.data[i];
+		direction[i] = (signed char)floor(dir.data[i]*127.0 + 0.5);
+	}
+	axis = 0;
+}
+
+// Sorts photons along one axis
+class PhotonLess
+{
+public:
+	PhotonLess(int axis) : axis(axis) { }
+	bool operator()(const Photon &a, const Photon &b) const
+	{ return a.position[axis] < b.position[axis]; }
+private:
+	int axis;
+};
+
+/**
+ * The photons closest to a point found so far. Once there are as many as
+ * we want, they are kept in a max-heap on the distance, so the furthest
+ * one can be replaced when a closer one is found.
+ */
+struct PhotonMap::Neighbours
+{
+	unsigned int count, wanted;
+	float maxDist2;
+	std::pair<float, unsigned int> found[PHOTON_MAX_NEIGHBOURS];
+
+	void add(float dist2, unsigned int index)
+	{
+		if (count < wanted) {
+			found[count++] = std::make_pair(dist2, index);
+			if (count == wanted) {
+				std::make_heap(found, found + count);
+				maxDist2 = found[0].first;
+			}
+		} else {
+			std::pop_heap(found, found + count);
+			found[count - 1] = std::make_pair(dist2, index);
+			std::push_heap(found, found + count);
+			maxDist2 = found[0].first;
+		}
+	}
+};
+
+void PhotonMap::add(const std::vector<Photon> &newPhotons)
+{
+	photons.insert(photons.end(), newPhotons.begin(), newPhotons.end());
+}
+
+void PhotonMap::balance()
+{
+	balance(0, photons.size());
+}
+
+void PhotonMap::balance(unsigned int first, unsigned int last)
+{
+	if (last - first < 2) {
+		if (first < last)
+			photons[first].axis = 0;
+		return;
+	}
+
+	// Split along the axis in which the photons are spread out the most
+	float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (unsigned int i = first; i < last; i++) {
+		for (int j = 0; j < 3; j++) {
+			min[j] = std::min(min[j], photons[i].position[j]);
+			max[j] = std::max(max[j], photons[i].position[j]);
+		}
+	}
+	int axis = 0;
+	for (int j = 1; j < 3; j++)
+		if (max[j] - min[j] > max[axis] - min[axis])
+			axis = j;
+
+	unsigned int mid = first + (last - first)/2;
+	std::nth_element(photons.begin() + first, photons.begin() + mid, photons.begin() + last, PhotonLess(axis));
+	photons[mid].axis = axis;
+
+	balance(first, mid);
+	balance(mid + 1, last);
+}
+
+void PhotonMap::locate(const float *p, const float *N, unsigned int first, unsigned int last, Neighbours &found) const
+{
+	if (first >= last)
+		return;
+
+	unsigned int mid = first + (last - first)/2;
+	const Photon &photon = photons[mid];
+
+	// Search the side p is on first, it's more likely to have close photons
+	if (last - first > 1) {
+		float d = p[photon.axis] - photon.position[photon.axis];
+		if (d < 0.0f) {
+			locate(p, N, first, mid, found);
+			if (d*d < found.maxDist2)
+				locate(p, N, mid + 1, last, found);
+		} else {
+			locate(p, N, mid + 1, last, found);
+			if (d*d < found.maxDist2)
+				locate(p, N, first, mid, found);
+		}
+	}
+
+	float dx = photon.position[0] - p[0], dy = photon.position[1] - p[1], dz = photon.position[2] - p[2];
+	float dist2 = dx*dx + dy*dy + dz*dz;
+	if (dist2 >= found.maxDist2)
+		return;
+	// Skip photons that arrived at the other side of the surface
+	if (N[0]*photon.direction[0] + N[1]*photon.direction[1] + N[2]*photon.direction[2] > 0.0f)
+		return;
+	found.add(dist2, mid);
+}
+
+Color PhotonMap::irradiance(const Point &p, const Vector &N) const
+{
+	Color result(0, 0, 0);
+	if (photons.empty())
+		return result;
+
+	float pf[3], Nf[3];
+	for (int i = 0; i < 3; i++) {
+		pf[i] = (float)p.data[i];
+		Nf[i] = (float)N.data[i];
+	}
+
+	Neighbours found;
+	found.count = 0;
+	found.wanted = neighbours;
+	found.maxDist2 = (float)(maxDistance*maxDistance);
+	locate(pf, Nf, 0, photons.size(), found);
+	if (found.count == 0)
+		return result;
+
+	for (unsigned int i = 0; i < found.count; i++) {
+		const Photon &photon = photons[found.found[i].second];
+		result += Color(photon.power[0], photon.power[1], photon.power[2]);
+	}
+
+	// The photons are spread out over a disc that just holds all of
+	// them, or the largest disc we search if there are too few
+	return result / (M_PI*found.maxDist2);
+}
@@ -0,0 +1,88 @@
+//
+//  Framework for a raytracer
+//  File: photonmap.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef PHOTONMAP_H
+#define PHOTONMAP_H
+
+#include <vector>
+#include "triple.h"
+
+// Upper limit for the number of photons a single estimate can use
+#define PHOTON_MAX_NEIGHBOURS 256
+
+/**
+ * A photon that landed on a surface
+ */
+struct Photon
+{
+	Photon() { }
+	Photon(const Point &p, const Vector &dir, const Color &color);
+
+	float position[3];
+	float power[3];
+	// Direction the photon travelled in, scaled to -127 .. 127
+	signed char direction[3];
+	// Axis this photon splits its part of the kd-tree along
+	unsigned char axis;
+};
+
+/**
+ * All photons in the scene, stored as a kd-tree so the photons closest
+ * to a point can be found quickly. The tree is implicit: the photons in
+ * a range are split by the one in the middle of the range, the photons
+ * before it lie on one side of it and the photons after it on the other.
+ */
+class PhotonMap
+{
+public:
+	PhotonMap() : neighbours(64), maxDistance(5.0) { }
+
+	void clear() { photons.clear(); }
+	// Add photons. The map must be balanced before it can be searched.
+	void add(const std::vector<Photon> &newPhotons);
+	// Build the kd-tree
+	void balance();
+
+	/**
+	 * Estimate the photon flux arriving per unit area at a point,
+	 * from the photons closest to it.
+	 * @param p Point to estimate the flux at
+	 * @param N Surface normal at p. Photons that hit the back of the surface
+	 *          are left out. Pass a zero vector to use all photons.
+	 * @return Flux density
+	 */
+	Color irradiance(const Point &p, const Vector &N) const;
+
+	bool isEmpty() const { return photons.empty(); }
+	unsigned int size() const { return photons.size(); }
+
+	// Number of photons an estimate uses, at most PHOTON_MAX_NEIGHBOURS
+	void setNeighbours(unsigned int n) { neighbours = n < 1 ? 1 : (n > PHOTON_MAX_NEIGHBOURS ? PHOTON_MAX_NEIGHBOURS : n); }
+	// Photons further away than this from a point never contribute to it
+	void setMaxDistance(double d) { maxDistance = d; }
+
+private:
+	std::vector<Photon> photons;
+	unsigned int neighbours;
+	double maxDistance;
+
+	struct Neighbours;
+
+	void balance(unsigned int first, unsigned int last);
+	void locate(const float *p, const float *N, unsigned int first, unsigned int last, Neighbours &found) const;
+};
+
+#endif /* end of include guard: PHOTONMAP_H */
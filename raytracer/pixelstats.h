@@ -0,0 +1,48 @@
+//
+//  Framework for a raytracer
+//  File: pixelstats.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef PIXELSTATS_H
+#define PIXELSTATS_H
+
+#include "triple.h"
+
+/**
+ * Running statistics of the samples taken in a pixel: their mean, how
+ * much they vary and how many there are. Samples are added one at a time
+ * (Welford's method), so nothing has to be kept per sample and the mean
+ * and variance stay accurate however many samples there are.
+ */
+struct PixelStats
+{
+	Color mean;
+	float m2;    // sum of the squared distances of the samples to the mean
+	float count; // number of samples
+
+	PixelStats() : mean(0, 0, 0), m2(0), count(0) { }
+
+	void add(const Color &c)
+	{
+		count += 1;
+		Color delta = c - mean;
+		mean += delta/count;
+		m2 += delta.dot(c - mean);
+	}
+
+	// Mean squared distance of the samples to their mean
+	float variance() const { return count > 0 ? m2/count : 0; }
+};
+
+#endif /* end of include guard: PIXELSTATS_H */
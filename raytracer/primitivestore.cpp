@@ -0,0 +1,181 @@
+//
+//  Framework for a raytracer
+//  File: primitivestore.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "primitivestore.h"
+#include "sphere.h"
+#include "triangle.h"
+#include "quad.h"
+#include "cylinder.h"
+
+void PrimitiveStore::clear()
+{
+	types.clear();
+	indices.clear();
+	objects.clear();
+	for (int i = 0; i < numTypes; i++)
+		counts[i] = 0;
+
+	spherePosition.clear();
+	sphereRadius.clear();
+	triangleP1.clear();
+	triangleP2.clear();
+	triangleP3.clear();
+	quadP1.clear();
+	quadP2.clear();
+	quadP3.clear();
+	quadP4.clear();
+	cylinderToObject.clear();
+	cylinderToWorld.clear();
+	cylinderRadius.clear();
+	cylinderLength.clear();
+	quadPackets.clear();
+	leafQuadPackets.clear();
+}
+
+void PrimitiveStore::add(Object *obj)
+{
+	Type type = other;
+	unsigned int index = 0;
+	if (Sphere *s = dynamic_cast<Sphere*>(obj)) {
+		type = sphere;
+		index = sphereRadius.size();
+		spherePosition.push_back(s->position);
+		sphereRadius.push_back(s->r);
+	} else if (Triangle *t = dynamic_cast<Triangle*>(obj)) {
+		type = triangle;
+		index = triangleP1.x.size();
+		triangleP1.push_back(t->p1);
+		triangleP2.push_back(t->p2);
+		triangleP3.push_back(t->p3);
+	} else if (Quad *q = dynamic_cast<Quad*>(obj)) {
+		type = quad;
+		index = quadP1.x.size();
+		quadP1.push_back(q->p1);
+		quadP2.push_back(q->p2);
+		quadP3.push_back(q->p3);
+		quadP4.push_back(q->p4);
+	} else if (Cylinder *c = dynamic_cast<Cylinder*>(obj)) {
+		type = cylinder;
+		index = cylinderRadius.size();
+		cylinderToObject.push_back(c->getWorldToObject());
+		cylinderToWorld.push_back(c->getObjectToWorld());
+		cylinderRadius.push_back(c->r);
+		cylinderLength.push_back(c->L);
+	}
+
+	types.push_back(type);
+	indices.push_back(index);
+	objects.push_back(obj);
+	counts[type]++;
+}
+
+void PrimitiveStore::packQuads(const BVH &bvh)
+{
+	quadPackets.clear();
+	leafQuadPackets.assign(size(), NO_PACKET);
+	const std::vector<BVH::Node> &nodes = bvh.getNodes();
+	for (unsigned int n = 0; n < nodes.size(); n++) {
+		if (nodes[n].count == 0)
+			continue;
+		unsigned int first = nodes[n].first, end = first + nodes[n].count, quads = 0;
+		for (unsigned int i = first; i < end; i++)
+			if (types[i] == quad)
+				quads++;
+		if (quads < 2)
+			continue;
+		
+		leafQuadPackets[first] = quadPackets.size();
+		unsigned int lane = 0;
+		for (unsigned int i = first; i < end; i++) {
+			if (types[i] != quad)
+				continue;
+			if (lane == 0)
+				quadPackets.push_back(TrianglePacket());
+			unsigned int j = indices[i];
+			quadPackets.back().set(lane, quadP1[j], quadP2[j], quadP3[j], i);
+			quadPackets.back().set(lane + 1, quadP1[j], quadP3[j], quadP4[j], i);
+			lane = (lane + 2) % TRIANGLE_PACKET_WIDTH;
+		}
+	}
+}
+
+inline Hit PrimitiveStore::intersect(unsigned int i, const Ray &ray, bool closest, double maxT) const
+{
+	unsigned int j = indices[i];
+	switch (types[i]) {
+		case sphere:
+			return Sphere::intersect(spherePosition[j], sphereRadius[j], ray, objects[i]);
+		case triangle:
+		{
+			Point p1 = triangleP1[j], p2 = triangleP2[j], p3 = triangleP3[j];
+			double t;
+			if (!Triangle::intersect(p1, p2, p3, ray, &t))
+				return Hit::NO_HIT();
+			return Hit(t, Triangle::normal(p1, p2, p3), objects[i]);
+		}
+		case quad:
+			return Quad::intersect(quadP1[j], quadP2[j], quadP3[j], quadP4[j], ray, objects[i]);
+		case cylinder:
+			return Cylinder::intersect(cylinderToObject[j], cylinderToWorld[j], cylinderRadius[j],
+				cylinderLength[j], ray, objects[i]);
+		default:
+			return objects[i]->intersect(ray, closest, maxT);
+	}
+}
+
+Hit PrimitiveStore::intersect(unsigned int first, unsigned int count, const Ray &ray, bool closest, double maxT, Object *ignore) const
+{
+	// The quads of a packed leaf are tested together after the rest
+	unsigned int packet = leafQuadPackets.empty() ? NO_PACKET : leafQuadPackets[first];
+	unsigned int quads = 0;
+	Hit min_hit = Hit::NO_HIT();
+	for (unsigned int i = first; i < first + count; ++i) {
+		if (packet != NO_PACKET && types[i] == quad) {
+			quads++;
+			continue;
+		}
+		if (objects[i] == ignore)
+			continue;
+		Hit hit = intersect(i, ray, closest, maxT);
+		if (hit.hasHit() && (hit.t < min_hit.t || !min_hit.hasHit()) && hit.t < maxT && hit.obj != ignore) {
+			min_hit = hit;
+			if (!closest)
+				break;
+		}
+	}
+	if (quads == 0 || (min_hit.hasHit() && !closest))
+		return min_hit;
+	
+	PacketRay packetRay(ray);
+	float packetT[TRIANGLE_PACKET_WIDTH];
+	unsigned int end = packet + (2*quads + TRIANGLE_PACKET_WIDTH - 1)/TRIANGLE_PACKET_WIDTH;
+	for (; packet < end; packet++) {
+		const TrianglePacket &p = quadPackets[packet];
+		int mask = p.intersect(packetRay, (float)(min_hit.hasHit() ? min_hit.t : maxT), packetT);
+		// Confirm the candidate quads in double precision
+		for (int lane = 0; lane < TRIANGLE_PACKET_WIDTH; lane += 2) {
+			if (!(mask & (3 << lane)) || objects[p.index[lane]] == ignore)
+				continue;
+			Hit hit = intersect(p.index[lane], ray, closest, maxT);
+			if (hit.hasHit() && (hit.t < min_hit.t || !min_hit.hasHit()) && hit.t < maxT) {
+				min_hit = hit;
+				if (!closest)
+					return min_hit;
+			}
+		}
+	}
+	return min_hit;
+}
@@ -0,0 +1,123 @@
+//
+//  Framework for a raytracer
+//  File: primitivestore.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef PRIMITIVESTORE_H
+#define PRIMITIVESTORE_H
+
+#include <vector>
+#include "object.h"
+#include "hit.h"
+#include "ray.h"
+#include "bvh.h"
+#include "trianglepacket.h"
+
+/**
+ * Compact copy of the geometry of a list of objects, for intersecting
+ * rays with them quickly. Spheres, triangles, quads and cylinders are
+ * copied into one table per type, with an array per coordinate
+ * (structure of arrays), so intersecting a run of primitives reads a few
+ * small arrays and calls no virtual functions. Any other object (models,
+ * CSG, instances) is kept as is and intersected through
+ * Object::intersect().
+ * Every primitive has a type tag and an index into the table of its type.
+ * Quads that share a BVH leaf are also packed into triangle packets, see
+ * packQuads().
+ * The materials and textures are only needed for shading, so they stay
+ * with the objects, which the store maps each primitive back to.
+ * Objects must not change after they are added.
+ */
+class PrimitiveStore
+{
+public:
+	enum Type {
+		sphere, triangle, quad, cylinder, other, numTypes
+	};
+
+	PrimitiveStore() { clear(); }
+
+	void clear();
+	// Append an object. Primitives are numbered in the order they are added.
+	void add(Object *obj);
+	/**
+	 * Pack the quads of every leaf of a BVH over the primitives into
+	 * shared triangle packets, so intersect() tests them all at once.
+	 * Leaves with a single quad keep testing it on its own.
+	 */
+	void packQuads(const BVH &bvh);
+
+	/**
+	 * Intersect a ray with primitives first .. first + count - 1.
+	 * @param ray Ray to intersect with
+	 * @param closest If true, make sure to return the closest intersection. If false, stop at the first intersection
+	 * @param maxT Ignore intersections with a t value greater than or equal to this
+	 * @param ignore Object to leave out, if any
+	 * @return Hit object
+	 */
+	Hit intersect(unsigned int first, unsigned int count, const Ray &ray, bool closest, double maxT, Object *ignore) const;
+
+	unsigned int size() const { return types.size(); }
+	Type getType(unsigned int i) const { return (Type)types[i]; }
+	Object *getObject(unsigned int i) const { return objects[i]; }
+	// Number of primitives of a type
+	unsigned int count(Type type) const { return counts[type]; }
+
+private:
+	std::vector<unsigned char> types;
+	std::vector<unsigned int> indices; // index in the table of the type
+	std::vector<Object*> objects;
+	unsigned int counts[numTypes];
+
+	// A point per primitive, one array per coordinate
+	struct Points
+	{
+		std::vector<double> x, y, z;
+		void push_back(const Point &p) { x.push_back(p.x); y.push_back(p.y); z.push_back(p.z); }
+		Point operator[](unsigned int i) const { return Point(x[i], y[i], z[i]); }
+		void clear() { x.clear(); y.clear(); z.clear(); }
+	};
+
+	Points spherePosition;
+	std::vector<double> sphereRadius;
+	Points triangleP1, triangleP2, triangleP3;
+	Points quadP1, quadP2, quadP3, quadP4;
+	std::vector<Transform> cylinderToObject, cylinderToWorld;
+	std::vector<double> cylinderRadius, cylinderLength;
+
+	// Packets of the leaves with more than one quad, with the two triangles
+	// of every quad in a pair of lanes. leafQuadPackets[first] is the first
+	// packet of the leaf starting at primitive first, or NO_PACKET.
+	std::vector<TrianglePacket> quadPackets;
+	std::vector<unsigned int> leafQuadPackets;
+	static const unsigned int NO_PACKET = ~0u;
+
+	inline Hit intersect(unsigned int i, const Ray &ray, bool closest, double maxT) const;
+};
+
+// Lets a BVH intersect rays with the primitives in a store
+class PrimitiveIntersector
+{
+public:
+	PrimitiveIntersector(const PrimitiveStore &primitives, Object *ignore) : primitives(primitives), ignore(ignore) { }
+	Hit operator()(unsigned int first, unsigned int count, const Ray &ray, bool closest, double maxT)
+	{
+		return primitives.intersect(first, count, ray, closest, maxT, ignore);
+	}
+private:
+	const PrimitiveStore &primitives;
+	Object *ignore;
+};
+
+#endif /* end of include guard: PRIMITIVESTORE_H */
@@ -9,17 +9,34 @@
 
 Hit Quad::intersect(const Ray &ray, bool closest, double maxT)
 {
+	return intersect(p1, p2, p3, p4, ray, this);
+}
+
+Hit Quad::intersect(const Point &p1, const Point &p2, const Point &p3, const Point &p4, const Ray &ray, Object *obj)
+{
+	// The quad is made of the triangles (p1, p2, p3) and (p1, p3, p4),
 	// simply pick the closest hit
-	static const double inf = std::numeric_limits<double>::infinity();
-	Hit h1 = t1->intersect(ray, true, inf);
-	Hit h2 = t2->intersect(ray, true, inf);
-	Hit h = ( (h1.t < h2.t) ? h1 : h2);
-	
-	h.makeObj(this);
-	return h;
+	double tA, tB;
+	bool hitA = Triangle::intersect(p1, p2, p3, ray, &tA);
+	bool hitB = Triangle::intersect(p1, p3, p4, ray, &tB);
+	if (hitA && (!hitB || tA < tB))
+		return Hit(tA, Triangle::normal(p1, p2, p3), obj);
+	if (hitB)
+		return Hit(tB, Triangle::normal(p1, p3, p4), obj);
+	return Hit::NO_HIT();
 }
 
 Point Quad::getRotationCenter()
 {
 	return (p1 + p2 + p3 + p4)/4;
-}
\ No newline at end of file
+}
+
+AABB Quad::getBounds()
+{
+	AABB box;
+	box.extend(p1);
+	box.extend(p2);
+	box.extend(p3);
+	box.extend(p4);
+	return box;
+}
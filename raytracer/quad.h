@@ -38,7 +38,13 @@ public:
 	}
 	
 	virtual Hit intersect(const Ray &ray, bool closest, double maxT);
+	/**
+	 * Intersect a ray with the quad (p1, p2, p3, p4)
+	 * @param obj Object the hit is reported for
+	 */
+	static Hit intersect(const Point &p1, const Point &p2, const Point &p3, const Point &p4, const Ray &ray, Object *obj);
 	virtual Point getRotationCenter();
+	virtual AABB getBounds();
 	
 	Point p1, p2, p3, p4;
 	Triangle *t1, *t2;
@@ -0,0 +1,71 @@
+//
+//  Framework for a raytracer
+//  File: random.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+/**
+ * Small random number generator (PCG32, see http://www.pcg-random.org/).
+ * Unlike rand() it keeps no shared state, so every thread or pixel can
+ * have its own generator without any locking. A generator is identified
+ * by a seed and a key, e.g. the pixel it is used for; the same seed and
+ * key always give the same numbers, whichever thread asks for them.
+ */
+class Random
+{
+public:
+	Random(uint64_t seed, uint64_t key = 0)
+	{
+		inc = (hash(key ^ hash(seed)) << 1) | 1;
+		state = 0;
+		next();
+		state += hash(seed + key);
+		next();
+	}
+
+	// Uniformly distributed 32-bit integer
+	uint32_t next()
+	{
+		uint64_t old = state;
+		state = old*6364136223846793005ULL + inc;
+		uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+		uint32_t rot = (uint32_t)(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+	}
+
+	// Uniformly distributed in [0, 1)
+	double uniform() { return next() * (1.0/4294967296.0); }
+
+	// Uniformly distributed in [min, max)
+	double uniform(double min, double max) { return min + (max - min)*uniform(); }
+
+	// Mix the bits of a number (the SplitMix64 finalizer), to turn
+	// neighbouring keys into unrelated ones
+	static uint64_t hash(uint64_t x)
+	{
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30))*0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27))*0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+
+private:
+	uint64_t state, inc;
+};
+
+#endif /* end of include guard: RANDOM_H */
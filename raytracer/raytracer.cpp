@@ -31,12 +31,16 @@
 #include <ctype.h>
 #include <fstream>
 #include <assert.h>
+#include <ctime>
+#include <limits>
 
 // Functions to ease reading from YAML input
-void operator >> (const YAML::Node& node, Triple& t);
+template <class T>
+void operator >> (const YAML::Node& node, TripleT<T>& t);
 Triple parseTriple(const YAML::Node& node);
 
-void operator >> (const YAML::Node& node, Triple& t)
+template <class T>
+void operator >> (const YAML::Node& node, TripleT<T>& t)
 {
 	assert(node.size()==3);
 	node[0] >> t.x;
@@ -133,7 +137,8 @@ Object* Raytracer::parseObject(const YAML::Node& node)
 		std::string name;
 		node["position"] >> pos;
 		node["name"] >> name;
-		Instance *inst = new Instance(pos, name);
+		double scale = parseOptionalDouble(node.FindValue("scale"), 1.0);
+		Instance *inst = new Instance(pos, name, axis, angle, scale);
 		
 		// Read and parse objects
 		const YAML::Node *objects = node.FindValue("objects");
@@ -144,6 +149,7 @@ Object* Raytracer::parseObject(const YAML::Node& node)
 				if (obj)
 					inst->addObject(obj);
 			}
+			inst->build();
 		}
 		
 		returnObject = inst;
@@ -165,7 +171,7 @@ Object* Raytracer::parseObject(const YAML::Node& node)
 		{
 			std::string texture;
 			*textureNode >> texture;
-			returnObject->texture = new Image(texture.c_str());
+			returnObject->texture = TextureCache::get(texture);
 		}
 		// Specular texture
 		const YAML::Node *specTextureNode = node.FindValue("speculartexture");
@@ -173,7 +179,7 @@ Object* Raytracer::parseObject(const YAML::Node& node)
 		{
 			std::string specTexture;
 			*specTextureNode >> specTexture;
-			returnObject->specularTexture = new Image(specTexture.c_str());
+			returnObject->specularTexture = TextureCache::get(specTexture);
 		}
 		// Bump map
 		const YAML::Node *bumpmapNode = node.FindValue("bumpmap");
@@ -181,7 +187,7 @@ Object* Raytracer::parseObject(const YAML::Node& node)
 		{
 			std::string bumpmap;
 			*bumpmapNode >> bumpmap;
-			returnObject->bumpmap = new Image(bumpmap.c_str());
+			returnObject->bumpmap = TextureCache::get(bumpmap, Texture::RGB16);
 		}
 		if (node.FindValue("bumpfactor"))
 			node["bumpfactor"] >> returnObject->bumpfactor;
@@ -191,7 +197,7 @@ Object* Raytracer::parseObject(const YAML::Node& node)
 		{
 			std::string darkmap;
 			*darkmapNode >> darkmap;
-			returnObject->darkmap = new Image(darkmap.c_str());
+			returnObject->darkmap = TextureCache::get(darkmap);
 		}
 		const YAML::Node *photonblurmapNode = node.FindValue("photonblurmap");
 		if (photonblurmapNode)
@@ -201,12 +207,11 @@ Object* Raytracer::parseObject(const YAML::Node& node)
 			returnObject->photonblurmap = new Image(photonblurmap.c_str());
 		}
 		const YAML::Node *photonmapNode = node.FindValue("photonmapSize");
+		// The texture is only allocated when RenderMode photon bakes it
 		if (!photonblurmapNode && photonmapNode)
-		{
-			int photonmapSize;
-			*photonmapNode >> photonmapSize;
-			returnObject->photonmap = new Image(photonmapSize, photonmapSize);
-		}
+			*photonmapNode >> returnObject->photonmapSize;
+		// Objects with a photon map texture always receive photons, others only on request
+		returnObject->receivesPhotons = parseBool(node.FindValue("photons"), photonmapNode != NULL);
 	}
 
 	return returnObject;
@@ -334,12 +339,18 @@ bool Raytracer::readScene(const std::string& inputFilename)
 			scene->setEdges(parseOptionalDouble(doc.FindValue("Edges"), 0.0));
 			scene->setMaxRecursionDepth(parseUnsignedInt(doc.FindValue("MaxRecursionDepth"), 0));
 			scene->setMinRecursionWeight(parseOptionalDouble(doc.FindValue("MinRecursionWeight"), 0.0));
+			scene->setRussianRoulette(parseBool(doc.FindValue("RussianRoulette"), false));
+			scene->setTileSize(parseUnsignedInt(doc.FindValue("TileSize"), 16));
+			// Without a fixed seed, every render comes out a little different
+			scene->setSeed(parseUnsignedInt(doc.FindValue("Seed"), (unsigned int)time(NULL)));
 			
 			if (doc.FindValue("Photon") != NULL)
 			{
 				scene->setPhotonFactor(parseUnsignedInt(doc["Photon"].FindValue("factor"), 0));
 				scene->setPhotonBlur(parseUnsignedInt(doc["Photon"].FindValue("blur"), 2));
 				scene->setPhotonIntensity(parseOptionalDouble(doc["Photon"].FindValue("intensity"), 0.0));
+				scene->setPhotonNeighbours(parseUnsignedInt(doc["Photon"].FindValue("neighbours"), 64));
+				scene->setPhotonRadius(parseOptionalDouble(doc["Photon"].FindValue("radius"), 5.0));
 			}
 			else
 			{
@@ -352,12 +363,14 @@ bool Raytracer::readScene(const std::string& inputFilename)
 			{
 				scene->setAmbient(
 					parseUnsignedInt(doc["Ambient"].FindValue("factor"), 0),
-					parseOptionalDouble(doc["Ambient"].FindValue("random"), 0.0)
+					parseOptionalDouble(doc["Ambient"].FindValue("random"), 0.0),
+					parseOptionalDouble(doc["Ambient"].FindValue("distance"), std::numeric_limits<double>::infinity()),
+					parseOptionalDouble(doc["Ambient"].FindValue("cache"), 0.0)
 				);
 			}
 			else
 			{
-				scene->setAmbient(0, 0.0);
+				scene->setAmbient(0, 0.0, 0.0, 0.0);
 			}
 			
 			if (doc.FindValue("SuperSampling") != NULL)
@@ -368,6 +381,8 @@ bool Raytracer::readScene(const std::string& inputFilename)
 					parseOptionalDouble(doc["SuperSampling"].FindValue("threshold"), 0.012),
 					parseBool(doc["SuperSampling"].FindValue("jitter"), true)
 				);
+				scene->setLowDiscrepancy(parseBool(doc["SuperSampling"].FindValue("lowDiscrepancy"), false));
+				scene->setSuperSamplingStopFraction(parseOptionalDouble(doc["SuperSampling"].FindValue("stopFraction"), 0.0));
 			}
 			else
 			{
@@ -393,7 +408,7 @@ bool Raytracer::readScene(const std::string& inputFilename)
 			{
 				std::string background;
 				*backgroundNode >> background;
-				scene->background = new Image(background.c_str());
+				scene->background = TextureCache::get(background);
 			}
 
 			// Read and parse the scene objects
@@ -431,6 +446,9 @@ bool Raytracer::readScene(const std::string& inputFilename)
 	}
 
 	cout << "YAML parsing results: " << scene->getNumObjects() << " objects read." << endl;
+
+	// Textures are only read now, so they can be decoded side by side
+	TextureCache::load();
 	return true;
 }
 
@@ -0,0 +1,70 @@
+//
+//  Framework for a raytracer
+//  File: sampler.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "random.h"
+
+/**
+ * Sample points for the camera rays of a pixel, spread evenly over the
+ * position in the pixel, the position on the lens and the time at once
+ * (the Halton sequence, which uses a different prime base for every
+ * dimension). Any number of consecutive points covers all dimensions
+ * about as evenly as a grid with that many points would, so passes can
+ * keep adding points to a pixel. Every pixel shifts the sequence by a
+ * random offset of its own, so neighbouring pixels don't repeat the same
+ * pattern.
+ */
+class Sampler
+{
+public:
+	enum Dimension {
+		pixelX, pixelY, lensU, lensV, time, numDimensions
+	};
+
+	Sampler(Random *rng)
+	{
+		for (int d = 0; d < numDimensions; d++)
+			shift[d] = rng->uniform();
+	}
+
+	// Coordinate of point i along a dimension, in [0, 1)
+	double get(unsigned int i, Dimension d) const
+	{
+		static const unsigned int bases[numDimensions] = { 2, 3, 5, 7, 11 };
+		double x = radicalInverse(i, bases[d]) + shift[d];
+		return x >= 1.0 ? x - 1.0 : x;
+	}
+
+	// Mirror the digits of i in the given base around the decimal point
+	static double radicalInverse(unsigned int i, unsigned int base)
+	{
+		double inverseBase = 1.0/base, f = inverseBase, x = 0.0;
+		while (i > 0)
+		{
+			x += (i % base)*f;
+			i /= base;
+			f *= inverseBase;
+		}
+		return x;
+	}
+
+private:
+	double shift[numDimensions];
+};
+
+#endif /* end of include guard: SAMPLER_H */
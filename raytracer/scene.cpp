@@ -22,9 +22,11 @@
 #include <cstdlib>
 #include <ctime>
 #include <omp.h>
+#include "tilescheduler.h"
+#include "stats.h"
 #include <string>
 
-Color Scene::trace(const Ray &ray, unsigned int recursionDepth, double recursionWeight, bool traceLights)
+Color Scene::trace(const Ray &ray, unsigned int recursionDepth, double recursionWeight, bool traceLights, Random *rng)
 {
 	if (recursionDepth > maxRecursionDepth || recursionWeight < minRecursionWeight)
 		return Color(0.0, 0.0, 0.0);
@@ -34,55 +36,133 @@ Color Scene::trace(const Ray &ray, unsigned int recursionDepth, double recursion
 		// No hit? Return background color
 		return backgroundColor(&ray.D);
 
-	Point hit = ray.at(min_hit.t); //the hit point
 	Object *obj = min_hit.obj;
-	Vector N = obj->getBumpedNormal(min_hit.N, hit); //the normal at hit point
-	Vector V = -ray.D; //the view vector
 	
 	// treat lights differently
 	if (obj->material->light) return obj->material->color;
 	
+	// The sample covers an area that grows with the distance. Only the
+	// distance from the last bounce is known, so reflections and
+	// refractions get slightly sharper textures than they should.
+	SurfaceInteraction si;
+	obj->getSurfaceInteraction(min_hit, ray, pixelSpread*min_hit.t, &si);
+	Vector V = -ray.D; //the view vector
+	Stats::add(Stats::shadedSamples);
+	
 	switch (mode)
 	{
 		case zbuffer:
 			return Color(min_hit.t/1000, min_hit.t/1000, min_hit.t/1000);
 		case normal:
-			return N/2+0.5;
+			return Color(si.N/2+0.5);
 		case texcoords:
-			double u, v;
-			obj->getTexCoords(hit, u, v);
-			return Color(u, v, 0);
+			if (!si.hasTexCoords)
+				obj->getHitTexCoords(min_hit, &si);
+			return Color(si.u, si.v, 0);
 		case gooch:
-			return calcGooch(obj, &hit, &N, &V, recursionDepth, recursionWeight);
+			return calcGooch(&si, &V, recursionDepth, recursionWeight, rng);
 		case phong:
 		default:
-			return calcPhong(obj, &hit, &N, &V, recursionDepth, recursionWeight);
+			return calcPhong(&si, &V, recursionDepth, recursionWeight, rng);
 	}
 }
 
+/**
+ * Intersect a ray with a range of objects, one by one.
+ * @param min_hit Closest hit found so far, replaced if a closer one is found
+ * @return Whether the search is over, i.e. closest is false and a hit was found
+ */
+static inline bool intersectObjects(Object * const *objects, unsigned int count, const Ray &ray, bool closest, double maxT, Object *ignore, Hit &min_hit)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		if (objects[i] == ignore)
+			continue;
+		Hit hit = objects[i]->intersect(ray, closest, maxT);
+		if (hit.hasHit() && (hit.t < min_hit.t || !min_hit.hasHit()) && hit.t < maxT && hit.obj != ignore) {
+			min_hit = hit;
+			if (!closest)
+				return true;
+		}
+	}
+	return false;
+}
+
+static inline bool intersectObjects(const std::vector<Object*> &objects, const Ray &ray, bool closest, double maxT, Object *ignore, Hit &min_hit)
+{
+	return !objects.empty() && intersectObjects(&objects[0], objects.size(), ray, closest, maxT, ignore, min_hit);
+}
+
 /**
  * Intersect a ray with all objects in the scene.
  * @param ray Ray to intersect with all objects
  * @param closest If true, make sure to return the closest intersection. If false, stop at the first intersection
  * @param maxT Ignore intersections with a t value greater than or equal to this
+ * @param traceLights If true, also intersect with the lights
+ * @param ignore Object to leave out, if any
  * @return Hit object
  */
-Hit Scene::intersectRay(const Ray &ray, bool closest, double maxT, bool traceLights)
+Hit Scene::intersectRay(const Ray &ray, bool closest, double maxT, bool traceLights, Object *ignore)
 {
 	// Find hit object and distance
-	Hit min_hit = Hit::NO_HIT();
+	PrimitiveIntersector isect(primitives, ignore);
+	Hit min_hit = bvh.intersect(ray, closest, maxT, isect);
+	if (min_hit.hasHit() && !closest)
+		return min_hit;
+	
+	// Objects that can't tell their size aren't in the BVH, so try them separately
+	if (intersectObjects(unboundedObjects, ray, closest, maxT, ignore, min_hit))
+		return min_hit;
+	
+	if (traceLights)
+		intersectObjects(lightObjects, ray, closest, maxT, ignore, min_hit);
+	
+	return min_hit;
+}
+
+/**
+ * (Re)build the BVH over all objects in the scene. Must be called
+ * after adding objects and before tracing any rays.
+ */
+void Scene::buildBVH()
+{
+	std::vector<Object*> boundedObjects;
+	unboundedObjects.clear();
+	lightObjects.clear();
+	std::vector<AABB> bounds;
 	
 	for (unsigned int i = 0; i < objects.size(); ++i) {
-		if (objects[i]->material->light && !traceLights) break;
-		Hit hit = objects[i]->intersect(ray, closest, maxT);
-		if (hit.hasHit() && (hit.t < min_hit.t || !min_hit.hasHit()) && hit.t < maxT) {
-			min_hit = hit;
-			if (!closest)
-				break;
+		// Lights are only intersected on request, see intersectRay()
+		if (objects[i]->material->light) {
+			lightObjects.push_back(objects[i]);
+			continue;
+		}
+		AABB box = objects[i]->getBounds();
+		// Nothing can hit an object with an empty box (e.g. the
+		// intersection of two objects that are apart)
+		if (box.isEmpty())
+			continue;
+		if (box.isInfinite()) {
+			unboundedObjects.push_back(objects[i]);
+		} else {
+			boundedObjects.push_back(objects[i]);
+			bounds.push_back(box);
 		}
 	}
 	
-	return min_hit;
+	printf("Building BVH over %u objects (%u unbounded)...\n",
+		(unsigned int)boundedObjects.size(), (unsigned int)unboundedObjects.size());
+	bvh.build(bounds, 2);
+	
+	// Store the objects in the order the BVH wants them
+	primitives.clear();
+	const std::vector<unsigned int> &order = bvh.getOrder();
+	for (unsigned int i = 0; i < order.size(); ++i)
+		primitives.add(boundedObjects[order[i]]);
+	primitives.packQuads(bvh);
+	printf("Primitive store: %u spheres, %u triangles, %u quads, %u cylinders, %u other objects\n",
+		primitives.count(PrimitiveStore::sphere), primitives.count(PrimitiveStore::triangle),
+		primitives.count(PrimitiveStore::quad), primitives.count(PrimitiveStore::cylinder),
+		primitives.count(PrimitiveStore::other));
 }
 
 inline Color Scene::backgroundColor(const Vector *V)
@@ -106,7 +186,7 @@ inline Vector Scene::reflectVector(Vector *N, Vector *V)
 }
 
 inline void Scene::reflect(Color *color, Object *obj, Point *hit, Vector *N, Vector *V, double ks,
-		unsigned int recursionDepth, double recursionWeight)
+		unsigned int recursionDepth, double recursionWeight, Random *rng)
 {	
 	// Trace a ray from this position along Vrefl, then treat
 	// the result as the color of an incoming light ray
@@ -120,32 +200,27 @@ inline void Scene::reflect(Color *color, Object *obj, Point *hit, Vector *N, Vec
 	{
 		Vector Vrefl = reflectVector(N, V);
 		Ray reflected(*hit + 0.01*Vrefl, Vrefl);
-		Color reflection = trace(reflected, recursionDepth + 1, recursionWeight*ks, false);
+		Stats::add(Stats::secondaryRays);
+		Color reflection = trace(reflected, recursionDepth + 1, recursionWeight*ks, false, rng);
 		*color += ks * reflection;
 	}
 }
 
-inline Vector Scene::refractVector(Object *obj, Point *hit, Vector *N, Vector *V, double nOut, double nIn)
+inline Vector Scene::refractVector(bool entering, Vector *N, Vector *V, double nOut, double nIn)
 {
 	// Compute the transmission vector using Snell's law
 	// Formulas from https://secure.wikimedia.org/wikipedia/en/wiki/Snell%27s_law#Vector_form
 	// with L replaced with -V
 	
 	// If the ray is leaving the object rather than entering it,
-	// we need to flip n1 and n2. We can detect this by constructing
-	// a ray that runs along V and starts just past the hit point,
-	// and intersecting that with the object again. If an
-	// intersection is found, that means we're entering the object.
-	Ray Vcont(*hit - 0.01*(*V), -*V);
-	Hit vcHit = obj->intersect(Vcont, true, std::numeric_limits<double>::infinity());
+	// we need to flip n1 and n2. The object told us which one it is
+	// when it was hit.
 	double n1, n2;
 	
-	if (vcHit.hasHit()) {
-		// Intersection found. We're entering
+	if (entering) {
 		n1 = nOut;
 		n2 = nIn;
 	} else {
-		// No intersection. We're exiting
 		n1 = nIn;
 		n2 = nOut;
 	}
@@ -166,8 +241,8 @@ inline Vector Scene::refractVector(Object *obj, Point *hit, Vector *N, Vector *V
 	}
 }
 
-inline void Scene::refract(Color *color, Object *obj, Point *hit, Vector *N, Vector *V,
-		unsigned int recursionDepth, double recursionWeight)
+inline void Scene::refract(Color *color, Object *obj, Point *hit, Vector *N, Vector *V, bool entering,
+		unsigned int recursionDepth, double recursionWeight, Random *rng)
 {
 	// Check the recursion guards here too
 	// We don't want trace() to return zero because the maximum recursion depth was hit,
@@ -176,44 +251,100 @@ inline void Scene::refract(Color *color, Object *obj, Point *hit, Vector *N, Vec
 		return;
 	
 	if (obj->material->refract >= 0.01) {
-		Vector T = refractVector(obj, hit, N, V, 1.0, obj->material->eta);
+		Vector T = refractVector(entering, N, V, 1.0, obj->material->eta);
 		
 		// Like with reflection, trace a ray along T and guard
 		// against roundoff errors
 		Ray refracted(*hit + 0.01*T, T);
-		Color refraction = trace(refracted, recursionDepth + 1, recursionWeight*obj->material->refract, true);
+		Stats::add(Stats::secondaryRays);
+		Color refraction = trace(refracted, recursionDepth + 1, recursionWeight*obj->material->refract, true, rng);
 		
 		// Blend the refracted color in
 		*color = (1 - obj->material->refract)*(*color) + obj->material->refract*refraction;
 	}
 }
 
-inline bool Scene::shadowed(Object *obj, Light *light, Vector *L)
+/**
+ * Add the reflection and refraction at a hit to its color. Normally both
+ * rays are traced, so the number of rays doubles with every bounce off
+ * glass. With Russian roulette only one of them is traced, picked with a
+ * probability that follows its weight, and when the weights add up to
+ * less than one the path may end instead. The chosen ray's color is
+ * divided by the probability of choosing it, so the result is the same
+ * on average, and every sample costs at most one ray per bounce.
+ * Supersampling averages out the extra noise.
+ */
+inline void Scene::reflectRefract(Color *color, SurfaceInteraction *si, Vector *V, double ks,
+		unsigned int recursionDepth, double recursionWeight, Random *rng)
 {
-	// Construct an object for the incoming light ray and check
-	// whether it intersects any other objects before this one
-	Ray lightRay(light->position, -1*(*L));
-	Hit ourHit = obj->intersect(lightRay, true, std::numeric_limits<double>::infinity());
-	return intersectRay(lightRay, false, ourHit.t, false).hasHit();
+	Object *obj = si->obj;
+	if (!russianRoulette)
+	{
+		reflect(color, obj, &si->p, &si->N, V, ks, recursionDepth, recursionWeight, rng);
+		refract(color, obj, &si->p, &si->N, V, si->entering, recursionDepth, recursionWeight, rng);
+		return;
+	}
+	
+	if (recursionDepth + 1 > maxRecursionDepth)
+		return;
+	
+	// The weights reflect() and refract() give both rays
+	double wRefract = obj->material->refract >= 0.01 ? obj->material->refract : 0.0;
+	double wReflect = ks > 0 ? (1 - wRefract)*ks : 0.0;
+	double total = wReflect + wRefract;
+	if (total <= 0)
+		return;
+	*color = (1 - wRefract)*(*color);
+	
+	// Pick a ray with probability w/scale, or none with 1 - total/scale.
+	// The weights take the place of minRecursionWeight, so the weight
+	// passed on doesn't shrink.
+	double scale = max(total, 1.0);
+	double u = rng->uniform(0.0, scale);
+	Vector dir;
+	bool refracted;
+	if (u < wReflect) {
+		dir = reflectVector(&si->N, V);
+		refracted = false;
+	} else if (u < total) {
+		dir = refractVector(si->entering, &si->N, V, 1.0, obj->material->eta);
+		refracted = true;
+	} else {
+		return;
+	}
+	
+	// Like in reflect() and refract(), guard against roundoff errors
+	Ray ray(si->p + 0.01*dir, dir);
+	Stats::add(Stats::secondaryRays);
+	*color += scale*trace(ray, recursionDepth + 1, recursionWeight, refracted, rng);
+}
+
+inline bool Scene::shadowed(Object *obj, Point *hit, Light *light, Vector *L)
+{
+	// Check whether any other object lies between the hit point and
+	// the light. The object itself doesn't cast shadows on itself, its
+	// back faces are already dark.
+	Ray shadowRay(*hit, *L);
+	return intersectRay(shadowRay, false, (light->position - *hit).length(), false, obj).hasHit();
 }
 
-inline void Scene::diffusePhong(Color *color, Object *obj, Point *hit, Light *light, Vector *L, Vector *N)
+inline void Scene::diffusePhong(Color *color, Object *obj, Color *objColor, Light *light, Vector *L, Vector *N)
 {
 	// Diffuse lighting
 	double NL = N->dot(*L);
 	// If the dot product is negative, the light is not
 	// visible to the viewer
 	if (NL >= 0) {
-		*color += obj->material->kd * obj->getColor(*hit) * light->color * NL;
+		*color += obj->material->kd * (*objColor) * light->color * NL;
 	}
 }
 
-inline void Scene::diffuseGooch(Color *color, Object *obj, Point *hit, Light *light, Vector *L, Vector *N, Vector *V)
+inline void Scene::diffuseGooch(Color *color, Object *obj, Color *objColor, Light *light, Vector *L, Vector *N, Vector *V)
 {
 	/* Gooch lighting */
 	double NL = N->dot(*L);
 	
-	Color diffuse = obj->material->kd * obj->getColor(*hit) * light->color;
+	Color diffuse = obj->material->kd * (*objColor) * light->color;
 	
 	Color kCool = Color(0.0, 0.0, goochB) + goochAlpha*diffuse;
 	Color kWarm = Color(goochY, goochY, 0.0) + goochBeta*diffuse;
@@ -232,39 +363,78 @@ inline void Scene::specular(Color *color, Object *obj, Light *light, Vector *L,
 	}
 }
 
-inline void Scene::ambient(Color *color, Object *obj, Point *hit, Vector *N)
+inline double Scene::occlusion(Point *hit, Vector *N, Random *rng, double *radius)
 {
-	double localAmbient = 1.0;
+	// Cast ambientFactor x ambientFactor rays over the hemisphere around
+	// the normal and count how many of them get away. The rays are spread
+	// over a grid on the unit disc, which is lifted onto the hemisphere, so
+	// they are cosine weighted: rays along the normal, which light the
+	// surface the most, are cast the most often. Only blockers closer than
+	// ambientDistance count, and any one of them will do, so the rays stop
+	// at the first hit they find unless the distances are needed.
+	double unblocked = 0.0, inverseDistances = 0.0;
+	Vector a = N->cross(fabs(N->x) > 0.5 ? Vector(0, 1, 0) : Vector(1, 0, 0)).normalized();
+	Vector b = N->cross(a);
 	
-	if (ambientFactor > 0)
+	Point p = *hit + (*N)*0.01;
+	
+	for (unsigned int x = 0; x < ambientFactor; x++)
 	{
-		localAmbient = 0.0;
-		Vector xvec(2,0,0), yvec(0,2,0), zvec(0,0,2), start(-1,-1,-1);
-		xvec /= (double)ambientFactor; yvec /= (double)ambientFactor; zvec /= (double)ambientFactor;
-		
-		Point p = *hit + (*N)*0.01;
-		
-		for (unsigned int x = 0; x < ambientFactor; x++)
+		for (unsigned int y = 0; y < ambientFactor; y++)
 		{
-			for (unsigned int y = 0; y < ambientFactor; y++)
-			{
-				for (unsigned int z = 0; z < ambientFactor; z++)
-				{
-					Vector v = start
-						+ ((double)x + ambientRandom*((double)rand()/(double)RAND_MAX - 0.5))*xvec
-						+ ((double)y + ambientRandom*((double)rand()/(double)RAND_MAX - 0.5))*yvec
-						+ ((double)z + ambientRandom*((double)rand()/(double)RAND_MAX - 0.5))*zvec;
-					Ray r(p, v);
-					Hit hit = intersectRay(r, false, std::numeric_limits<double>::infinity(), false);
-					if (!hit.hasHit()) localAmbient += 1.0;
-				}
-			}
+			double u1 = ((double)x + 0.5 + ambientRandom*(rng->uniform() - 0.5))/ambientFactor;
+			double u2 = ((double)y + 0.5 + ambientRandom*(rng->uniform() - 0.5))/ambientFactor;
+			double r = sqrt(max(0.0, min(u1, 1.0)));
+			double phi = 2*M_PI*u2;
+			double h = sqrt(max(0.0, 1.0 - r*r));
+			Ray ray(p, r*cos(phi)*a + r*sin(phi)*b + h*(*N));
+			Hit hit = intersectRay(ray, radius != NULL, ambientDistance, false);
+			if (!hit.hasHit()) unblocked += 1.0;
+			inverseDistances += 1.0/(hit.hasHit() ? hit.t : ambientDistance);
 		}
-		
-		localAmbient /= (double)(ambientFactor*ambientFactor*ambientFactor);
-	}	
+	}
+	Stats::add(Stats::ambientRays, ambientFactor*ambientFactor);
+	
+	if (radius)
+	{
+		*radius = inverseDistances > 0.0 ? (double)(ambientFactor*ambientFactor)/inverseDistances
+			: std::numeric_limits<double>::infinity();
+		*radius = max(ambientMinRadius, min(*radius, ambientMaxRadius));
+	}
+	return unblocked/(double)(ambientFactor*ambientFactor);
+}
+
+inline double Scene::cachedOcclusion(Point *hit, Vector *N, Random *rng)
+{
+	// Interpolate the samples of the cache that are close enough. This
+	// thread's own samples of the current pass are searched as well.
+	OcclusionCache *own = &ambientThreadCaches[omp_get_thread_num()];
+	double weight = 0.0, sum = 0.0;
+	ambientCache.lookup(*hit, *N, &weight, &sum);
+	own->lookup(*hit, *N, &weight, &sum);
+	if (weight > 0.0)
+	{
+		Stats::add(Stats::ambientCacheHits);
+		return sum/weight;
+	}
 	
-	*color += obj->material->ka * obj->getColor(*hit) * globalAmbient * localAmbient;
+	double radius;
+	double result = occlusion(hit, N, rng, &radius);
+	Stats::add(Stats::ambientCacheMisses);
+	// Without any geometry to limit it, a sample would be valid everywhere
+	if (radius < std::numeric_limits<double>::infinity())
+		own->add(*hit, *N, radius, result);
+	return result;
+}
+
+inline void Scene::ambient(Color *color, Object *obj, Color *objColor, Point *hit, Vector *N, Random *rng)
+{
+	double localAmbient = 1.0;
+	
+	if (ambientFactor > 0)
+		localAmbient = ambientCacheError > 0.0 ? cachedOcclusion(hit, N, rng) : occlusion(hit, N, rng, NULL);
+	
+	*color += obj->material->ka * (*objColor) * globalAmbient * localAmbient;
 }
 
 inline bool Scene::edgeDetection(Color *color, Vector *N, Vector *V)
@@ -286,28 +456,36 @@ inline Vector Scene::lightVector(Point *hit, Light *light)
 	return (light->position - *hit).normalized();
 }
 
-inline void Scene::photons(Color *color, Object *obj, Point *hit)
+inline void Scene::photons(Color *color, SurfaceInteraction *si, Vector *V)
 {
-	*color += obj->getPhotons(*hit);
+	// Photon maps loaded from a file replace the traced photons
+	if (si->obj->photonblurmap)
+		*color += si->obj->getPhotons(*si);
+	else if (si->obj->receivesPhotons) {
+		// Gather the photons on the side we look at, which for objects
+		// that aren't closed (e.g. triangles) can be the back
+		Vector N = si->N.dot(*V) < 0 ? -1*si->N : si->N;
+		*color += photonMap.irradiance(si->p, N);
+	}
 }
 
-inline void Scene::darkmap(Color *color, Object *obj, Point *hit)
+inline void Scene::darkmap(Color *color, SurfaceInteraction *si)
 {
-	if (obj->darkmap)
-	{
-		double u, v;
-		obj->getTexCoords(*hit, u, v);
-		*color += (1-color->length_2()) * obj->darkmap->colorAt(u, v);
-	}
+	if (si->obj->darkmap)
+		*color += (1-color->length_2()) * si->obj->darkmap->colorAt(si->u, si->v, si->fp);
 }
 
-Color Scene::calcPhong(Object *obj, Point *hit, Vector *N, Vector *V, unsigned int recursionDepth, double recursionWeight)
+Color Scene::calcPhong(SurfaceInteraction *si, Vector *V, unsigned int recursionDepth, double recursionWeight, Random *rng)
 {
+	Object *obj = si->obj;
+	Point *hit = &si->p;
+	Vector *N = &si->N;
 	Color color(0.0, 0.0, 0.0);
-	double ks = obj->getKs(*hit);
+	Color objColor = obj->getColor(*si);
+	double ks = obj->getKs(*si);
 	
-	ambient(&color, obj, hit, N);
-	photons(&color, obj, hit);
+	ambient(&color, obj, &objColor, hit, N, rng);
+	photons(&color, si, V);
 	
 	if (edgeDetection(&color, N, V)) return color;
 	
@@ -318,31 +496,34 @@ Color Scene::calcPhong(Object *obj, Point *hit, Vector *N, Vector *V, unsigned i
 		
 		// If this light ray is shadowed from this object by some other
 		// object, ignore it.
-		if (shadowed(obj, lights[i], &L) && shadows) {
+		if (shadows && shadowed(obj, hit, lights[i], &L)) {
 			continue;
 		}
 		
-		diffusePhong(&color, obj, hit, lights[i], &L, N);
+		diffusePhong(&color, obj, &objColor, lights[i], &L, N);
 		specular(&color, obj, lights[i], &L, N, V, ks);
 	}
 	
 	// Reflection and refraction
-	reflect(&color, obj, hit, N, V, ks, recursionDepth, recursionWeight);
-	refract(&color, obj, hit, N, V, recursionDepth, recursionWeight);
+	reflectRefract(&color, si, V, ks, recursionDepth, recursionWeight, rng);
 	
 	// Dark map
-	darkmap(&color, obj, hit);
+	darkmap(&color, si);
 	
 	color.clamp();
 	return color;
 }
 
-Color Scene::calcGooch(Object *obj, Point *hit, Vector *N, Vector *V, unsigned int recursionDepth, double recursionWeight)
+Color Scene::calcGooch(SurfaceInteraction *si, Vector *V, unsigned int recursionDepth, double recursionWeight, Random *rng)
 {
+	Object *obj = si->obj;
+	Point *hit = &si->p;
+	Vector *N = &si->N;
 	Color color(0.0, 0.0, 0.0);
-	double ks = obj->getKs(*hit);
+	Color objColor = obj->getColor(*si);
+	double ks = obj->getKs(*si);
 	
-	photons(&color, obj, hit);
+	photons(&color, si, V);
 	
 	if (edgeDetection(&color, N, V)) return color;
 	
@@ -353,26 +534,25 @@ Color Scene::calcGooch(Object *obj, Point *hit, Vector *N, Vector *V, unsigned i
 		
 		// If this light ray is shadowed from this object by some other
 		// object, ignore it.
-		if (shadowed(obj, lights[i], &L) && shadows) {
+		if (shadows && shadowed(obj, hit, lights[i], &L)) {
 			continue;
 		}
 		
-		diffuseGooch(&color, obj, hit, lights[i], &L, N, V);
+		diffuseGooch(&color, obj, &objColor, lights[i], &L, N, V);
 		specular(&color, obj, lights[i], &L, N, V, ks);
 	}
 	
 	// Reflection and refraction
-	reflect(&color, obj, hit, N, V, ks, recursionDepth, recursionWeight);
-	refract(&color, obj, hit, N, V, recursionDepth, recursionWeight);
+	reflectRefract(&color, si, V, ks, recursionDepth, recursionWeight, rng);
 	
 	// Dark map
-	darkmap(&color, obj, hit);
+	darkmap(&color, si);
 	
 	color.clamp();
 	return color;
 }
 
-inline Color Scene::anaglyphRay(Point pixel, Point eye)
+inline Color Scene::anaglyphRay(Point pixel, Point eye, Random *rng)
 {
 	if (camera.anaglyph)
 	{
@@ -380,8 +560,8 @@ inline Color Scene::anaglyphRay(Point pixel, Point eye)
 		Point rightEye = eye + camera.eyesOffset;
 		Ray leftRay(leftEye, (pixel-leftEye).normalized());
 		Ray rightRay(rightEye, (pixel-rightEye).normalized());
-		Color leftCol = trace(leftRay, 0, 1, true);
-		Color rightCol = trace(rightRay, 0, 1, true);
+		Color leftCol = trace(leftRay, 0, 1, true, rng);
+		Color rightCol = trace(rightRay, 0, 1, true, rng);
 		if (camera.grey)
 		{
 			leftCol.set(leftCol.r + leftCol.g + leftCol.b, 3);
@@ -394,12 +574,12 @@ inline Color Scene::anaglyphRay(Point pixel, Point eye)
 	else
 	{
 		Ray ray(eye, (pixel-eye).normalized());
-		Color finalCol = trace(ray, 0, 1, true);
+		Color finalCol = trace(ray, 0, 1, true, rng);
 		return finalCol;
 	}
 }
 
-inline Color Scene::exposureRay(Point pixel, Point eye)
+inline Color Scene::exposureRay(Point pixel, Point eye, Random *rng)
 {
 	Color col(0,0,0);
 	
@@ -407,13 +587,13 @@ inline Color Scene::exposureRay(Point pixel, Point eye)
 	{
 		double time = (double)i * camera.exposureTime / (double)camera.exposureSamples;
 		Point motionEye = eye + camera.velocity*time + camera.acceleration*time*time/2.0;
-		col += anaglyphRay(pixel, motionEye);
+		col += anaglyphRay(pixel, motionEye, rng);
 	}
 	col /= camera.exposureSamples;
 	return col;
 }
 
-inline Color Scene::apertureRay(Point pixel, unsigned int subpixel)
+inline Color Scene::apertureRay(Point pixel, unsigned int subpixel, Random *rng)
 {
 	Color col(0,0,0);
 	
@@ -429,96 +609,145 @@ inline Color Scene::apertureRay(Point pixel, unsigned int subpixel)
 		double theta = (double)(i + subpixel) * 2.399963;
 		
 		Point eye = camera.eye + xvec*r*cos(theta) + yvec*r*sin(theta);
-		col += exposureRay(pixel, eye);
+		col += exposureRay(pixel, eye, rng);
 	}
 	col /= camera.apertureSamples;
 	return col;
 }
 
-
-void Scene::superSampleRay(Color * totalCol, double * variance, unsigned int nPoints, Point origPixel, Vector xvec, Vector yvec, unsigned int factor)
+inline Color Scene::sampledRay(Point pixel, Vector xvec, Vector yvec, const Sampler *sampler, unsigned int i, Random *rng)
 {
-	unsigned int i=0;
-	unsigned int num = factor*factor;
-	
-	Color colGrid[num];
-	Vector xoffset, yoffset, xstart, ystart, xvec2, yvec2;
-	
-	xvec2 = xvec / ((double)factor-1.0);
-	yvec2 = yvec / ((double)factor-1.0);
+	// A single camera ray, whose position in the pixel, on the lens and in
+	// time all come from point i of the sampler
+	pixel += xvec*(sampler->get(i, Sampler::pixelX) - 0.5) + yvec*(sampler->get(i, Sampler::pixelY) - 0.5);
 	
-	xstart = -xvec2*(double)factor/2.0;
-	ystart = -yvec2*(double)factor/2.0;
+	Point eye = camera.eye;
+	if (camera.apertureRadius > 0.0)
+	{
+		Vector lensX = (camera.center-camera.eye).normalized().cross(camera.up).normalized();
+		Vector lensY = -camera.up.normalized();
+		double r = sqrt(sampler->get(i, Sampler::lensU))*camera.apertureRadius/camera.up.length();
+		double theta = 2*M_PI*sampler->get(i, Sampler::lensV);
+		eye += lensX*r*cos(theta) + lensY*r*sin(theta);
+	}
 	
-	int subpixel = nPoints;
-	for (int y = 0; y < (int)factor; y++)
+	double time = sampler->get(i, Sampler::time)*camera.exposureTime;
+	eye += camera.velocity*time + camera.acceleration*time*time/2.0;
+	return anaglyphRay(pixel, eye, rng);
+}
+
+void Scene::superSampleRay(PixelStats *stats, unsigned int nPoints, Point origPixel, Vector xvec, Vector yvec, unsigned int factor, const Sampler *sampler, Random *rng)
+{
+	if (sampler)
+	{
+		// Continue the pixel's sequence where the previous passes left off
+		for (unsigned int i = 0; i < factor*factor; i++)
+			stats->add(sampledRay(origPixel, xvec, yvec, sampler, nPoints + i, rng));
+	}
+	else
 	{
-		for (int x = 0; x < (int)factor; x++)
+		Vector xoffset, yoffset, xstart, ystart, xvec2, yvec2;
+		
+		xvec2 = xvec / ((double)factor-1.0);
+		yvec2 = yvec / ((double)factor-1.0);
+		
+		xstart = -xvec2*(double)factor/2.0;
+		ystart = -yvec2*(double)factor/2.0;
+		
+		int subpixel = nPoints;
+		for (int y = 0; y < (int)factor; y++)
 		{
-			Vector xoffset = xvec2*(double)x + xstart;
-			Vector yoffset = yvec2*(double)y + ystart;
-
-			if (superSamplingJitter)
+			for (int x = 0; x < (int)factor; x++)
 			{
-				xoffset += xvec2*((double)rand()/(double)RAND_MAX - 0.5);
-				yoffset += yvec2*((double)rand()/(double)RAND_MAX - 0.5);
-			}
+				Vector xoffset = xvec2*(double)x + xstart;
+				Vector yoffset = yvec2*(double)y + ystart;
 
-			Point pixel = origPixel + xoffset + yoffset;
-			colGrid[i] = apertureRay(pixel, subpixel++);
-			*totalCol += colGrid[i++];
+				if (superSamplingJitter)
+				{
+					xoffset += xvec2*(rng->uniform() - 0.5);
+					yoffset += yvec2*(rng->uniform() - 0.5);
+				}
+
+				Point pixel = origPixel + xoffset + yoffset;
+				stats->add(apertureRay(pixel, subpixel++, rng));
+			}
 		}
 	}
-	
-	Color avgCol = *totalCol / (nPoints + num);
-	
-	*variance = 0.0;
-	for (unsigned int i = 0; i < num; i++)
-	{
-		*variance += (colGrid[i] - avgCol).length_2();
-	}
-	*variance /= num;
 }
 
-void Scene::renderPass(Image &img, Image &depthImg, Image &variance, Vector xvec, Vector yvec, unsigned int nPoints, unsigned int factor)
+void Scene::renderPass(std::vector<PixelStats> &pixels, std::vector<int> &unconverged, Vector xvec, Vector yvec, unsigned int nPoints, unsigned int factor)
 {
 	int w = camera.viewWidth;
 	int h = camera.viewHeight;
-	int done = 0, lastPercent = 0;
+	int lastPercent = 0;
 	Point pos = camera.center - yvec*(double)h/2.0 - xvec*(double)w/2.0;
+	// Pixels are one unit apart on the view plane, and this pass splits
+	// them into factor x factor samples
+	pixelSpread = 1.0/((camera.center - camera.eye).length()*factor);
+	TileScheduler scheduler(w, h, tileSize, omp_get_max_threads());
 	
-	#pragma omp parallel for
-	for (int y = 0; y < h; y++)
+	#pragma omp parallel
 	{
-		#pragma omp parallel for
-		for (int x = 0; x < w; x++)
+		int thread = omp_get_thread_num();
+		Tile tile;
+		while (scheduler.next(thread, &tile))
 		{
-			if (variance(x,y).r >= superSamplingThresholdSquared || factor <= superSamplingMinFactor)
+			// Tiles that converged in an earlier pass get no more samples
+			if (unconverged[tile.index] == 0 && factor > superSamplingMinFactor)
 			{
-				unsigned int num = factor*factor;
-				depthImg(x,y) += Color(num, num, num);
-				if (!(mode == ssdepth && (nPoints + num) > superSamplingTotal))
+				scheduler.addDone(thread, tile.getNumPixels());
+				continue;
+			}
+			
+			int left = 0;
+			for (int y = tile.y0; y < tile.y1; y++)
+			{
+				for (int x = tile.x0; x < tile.x1; x++)
 				{
-					Point pixel = pos + yvec*(double)y + xvec*(double)x;
-					if (factor > 1)
-					{
-						superSampleRay(&img(x,y), &variance(x,y).r, nPoints, pixel, xvec, yvec, factor);
-					}
-					else
+					PixelStats &stats = pixels[y*w + x];
+					if (stats.variance() >= superSamplingThresholdSquared || factor <= superSamplingMinFactor)
 					{
-						img(x,y) = apertureRay(pixel, 0);
+						unsigned int num = factor*factor;
+						// The depth image only needs the number of samples
+						if (mode == ssdepth && (nPoints + num) > superSamplingTotal)
+							stats.count += num;
+						else
+						{
+							Point pixel = pos + yvec*(double)y + xvec*(double)x;
+							// Every pixel and pass gets its own random numbers, so the
+							// image doesn't depend on which thread renders what
+							Random rng(seed, ((uint64_t)nPoints*h + y)*w + x);
+							if (lowDiscrepancy)
+							{
+								// The sampler has to be the same in every pass
+								Random shifts(seed, ((uint64_t)1 << 63) | ((uint64_t)y*w + x));
+								Sampler sampler(&shifts);
+								superSampleRay(&stats, nPoints, pixel, xvec, yvec, factor, &sampler, &rng);
+							}
+							else if (factor > 1)
+							{
+								superSampleRay(&stats, nPoints, pixel, xvec, yvec, factor, NULL, &rng);
+							}
+							else
+							{
+								stats.add(apertureRay(pixel, 0, &rng));
+							}
+						}
 					}
+					if (stats.variance() >= superSamplingThresholdSquared)
+						left++;
 				}
 			}
+			unconverged[tile.index] = left;
 			
-			#pragma omp atomic
-				done++;
+			scheduler.addDone(thread, tile.getNumPixels());
 			
-			if (omp_get_thread_num() == 0)
+			if (thread == 0)
 			{
-				if ((int)((done*100)/(w*h)) > lastPercent)
+				int percent = (int)(((long long)scheduler.getDone()*100)/(w*h));
+				if (percent > lastPercent)
 				{
-					lastPercent = (done*100)/(w*h);
+					lastPercent = percent;
 					printf("%i%% ", lastPercent);
 					fflush(stdout);
 				}
@@ -529,6 +758,23 @@ void Scene::renderPass(Image &img, Image &depthImg, Image &variance, Vector xvec
 	printf("\n");
 }
 
+void Scene::initOcclusionCache()
+{
+	ambientCache.clear(ambientCacheError);
+	ambientThreadCaches.assign(omp_get_max_threads(), OcclusionCache());
+	for (unsigned int i = 0; i < ambientThreadCaches.size(); i++)
+		ambientThreadCaches[i].clear(ambientCacheError);
+	
+	// Samples far from any blocker are valid in large spheres, but not
+	// beyond a quarter of the scene, so curved surfaces in the open still
+	// get samples of their own. Samples right next to a blocker would be
+	// valid only at their own point, so they are made a bit larger.
+	AABB bounds = bvh.getBounds();
+	double size = bounds.isEmpty() ? 0.0 : bounds.extent().length();
+	ambientMaxRadius = size > 0.0 ? min(ambientDistance, size/4) : ambientDistance;
+	ambientMinRadius = ambientMaxRadius < std::numeric_limits<double>::infinity() ? ambientMaxRadius/100 : 0.0;
+}
+
 void Scene::computeGlobalAmbient()
 {
 	globalAmbient = Color(0.0, 0.0, 0.0);
@@ -541,7 +787,7 @@ void Scene::computeGlobalAmbient()
 	globalAmbient.clamp();
 }
 
-void Scene::tracePhoton(Color color, const Ray &ray, unsigned int recursionDepth, double recursionWeight, Object *onlyObject)
+void Scene::tracePhoton(Color color, const Ray &ray, unsigned int recursionDepth, double recursionWeight, Object *onlyObject, std::vector<Photon> *store)
 {
 	if (recursionDepth > maxRecursionDepth || recursionWeight < minRecursionWeight)
 		return;
@@ -550,40 +796,39 @@ void Scene::tracePhoton(Color color, const Ray &ray, unsigned int recursionDepth
 	if (!min_hit.hasHit() || (onlyObject && min_hit.obj != onlyObject))
 		return;
 
-	Point hit = ray.at(min_hit.t); //the hit point
 	Object *obj = min_hit.obj;
-	Vector N = obj->getBumpedNormal(min_hit.N, hit); //the normal at hit point
+	SurfaceInteraction si;
+	obj->getSurfaceInteraction(min_hit, ray, 0.0, &si);
+	Point hit = si.p; //the hit point
+	Vector N = si.N; //the normal at hit point
 	Vector V = -ray.D; //the view vector
-	double ks = obj->getKs(hit);
+	double ks = obj->getKs(si);
 	
-	if (obj->photonmap && recursionDepth > 0)
-	{
-		#pragma omp critical
-		{
-			obj->addPhoton(hit, color);
-		}
-	}
+	// Only store photons that were reflected or refracted on their way
+	// here, direct light is computed separately
+	if (recursionDepth > 0 && obj->receivesPhotons)
+		store->push_back(Photon(hit, ray.D, color));
 	
 	if (ks > 0)
 	{
 		Vector Vrefl = reflectVector(&N, &V);
 		Ray reflected(hit + 0.01*Vrefl, Vrefl);
-		tracePhoton(ks*color, reflected, recursionDepth + 1, ks*recursionWeight, NULL);
+		tracePhoton(ks*color, reflected, recursionDepth + 1, ks*recursionWeight, NULL, store);
 	}
 	
 	if (obj->material->refract >= 0.01) {
-		Vector T = refractVector(obj, &hit, &N, &V, obj->material->eta, 1.0);
+		Vector T = refractVector(min_hit.entering, &N, &V, obj->material->eta, 1.0);
 		
 		// Like with reflection, trace a ray along T and guard
 		// against roundoff errors
 		Ray refracted(hit + 0.01*T, T);
 		
-		tracePhoton(obj->material->refract*obj->getColor(hit)*color, refracted, 
-			recursionDepth + 1, obj->material->refract*recursionWeight, NULL);
+		tracePhoton(obj->material->refract*obj->getColor(si)*color, refracted, 
+			recursionDepth + 1, obj->material->refract*recursionWeight, NULL, store);
 	}
 }
 
-void Scene::renderPhotonsForLightAndObject(Light *light, Object *obj)
+void Scene::renderPhotonRow(Light *light, Object *obj, int y, std::vector<Photon> *store)
 {
 	Point pos = obj->getRotationCenter();
 	Vector xvec = (light->position - pos).cross(camera.up).normalized() * (obj->getRadius()*2.1/(double)photonFactor);
@@ -591,30 +836,14 @@ void Scene::renderPhotonsForLightAndObject(Light *light, Object *obj)
 	
 	pos = pos - xvec*(double)photonFactor/2.0 - yvec*(double)photonFactor/2.0;
 	
-	#pragma omp parallel for
-	for (int y = 0; y < photonFactor; y++)
-	{
-		#pragma omp parallel for
-		for (int x = 0; x < photonFactor; x++)
-		{
-			Point pixel = pos + yvec*(double)y + xvec*(double)x;
-			Vector dir = pixel - light->position;
-			Ray r(light->position, dir.normalized());
-			
-			// intensity is already corrected for number of samples
-			tracePhoton(photonIntensity*100000.0/dir.length_2()*light->color, r, 0, 1.0, obj);
-		}
-	}
-}
-
-void Scene::renderPhotonsForLight(Light *light)
-{
-	#pragma omp parallel for
-	for (int i = 0; i < (int)objects.size(); ++i)
+	for (int x = 0; x < photonFactor; x++)
 	{
-		Object *obj = objects[i];
-		if (obj->material->ks >= 0.01 || obj->material->refract >= 0.01)
-			renderPhotonsForLightAndObject(light, obj);
+		Point pixel = pos + yvec*(double)y + xvec*(double)x;
+		Vector dir = pixel - light->position;
+		Ray r(light->position, dir.normalized());
+		
+		// intensity is already corrected for number of samples
+		tracePhoton(photonIntensity*100000.0/dir.length_2()*light->color, r, 0, 1.0, obj, store);
 	}
 }
 
@@ -623,30 +852,80 @@ void Scene::renderPhotons()
 	// correct intensity for number of samples
 	photonIntensity /= (double)(photonFactor*photonFactor);
 	
-	#pragma omp parallel for
-	for (int i = 0; i < (int)lights.size(); i++)
+	// Shoot photons from every light at every object that reflects or refracts them
+	std::vector<Light*> photonLights;
+	std::vector<Object*> photonObjects;
+	for (unsigned int i = 0; i < lights.size(); i++)
+	{
+		for (unsigned int j = 0; j < objects.size(); j++)
+		{
+			if (objects[j]->material->ks >= 0.01 || objects[j]->material->refract >= 0.01)
+			{
+				photonLights.push_back(lights[i]);
+				photonObjects.push_back(objects[j]);
+			}
+		}
+	}
+	
+	// Hand out single rows, so all threads keep busy even if there is
+	// only one light and object. Every row stores its photons separately,
+	// which saves locking and keeps the order of the photons fixed.
+	int rows = photonLights.size()*photonFactor;
+	std::vector< std::vector<Photon> > rowPhotons(rows);
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < rows; i++)
 	{
-		renderPhotonsForLight(lights[i]);
+		renderPhotonRow(photonLights[i/photonFactor], photonObjects[i/photonFactor], i % photonFactor, &rowPhotons[i]);
 	}
+	
+	photonMap.clear();
+	for (int i = 0; i < rows; i++)
+	{
+		photonMap.add(rowPhotons[i]);
+		std::vector<Photon>().swap(rowPhotons[i]);
+	}
+	printf("Balancing photon map of %u photons...\n", photonMap.size());
+	photonMap.balance();
 }
 
-void Scene::blurPhotonMaps()
+void Scene::bakePhotonMaps()
 {
-	#pragma omp parallel for
+	// Sample the photon map at every pixel of the objects' photon map
+	// textures, so they can be saved and loaded again as photonblurmap
 	for (int i = 0; i < (int)objects.size(); ++i)
 	{
-		if (objects[i]->photonmap) objects[i]->blurPhotonMap(photonBlur);
+		int size = objects[i]->photonmapSize;
+		if (size <= 0)
+			continue;
+		
+		Image *map = new Image(size, size);
+		int w = size, h = size;
+		#pragma omp parallel for
+		for (int y = 0; y < h; y++)
+		{
+			for (int x = 0; x < w; x++)
+			{
+				Point p = objects[i]->getPointFromTexCoords((double)x/(w - 1), (double)y/(h - 1));
+				Color c = photonMap.irradiance(p, Vector(0, 0, 0));
+				c.clamp();
+				(*map)(x, y) = c;
+			}
+		}
+		objects[i]->blurPhotonMap(map, photonBlur);
+		delete map;
 	}
 }
 
 void Scene::writePhotonMaps(const std::string& filename)
 {
+	buildBVH();
+	
 	if (photonFactor > 0)
 	{
 		printf("Tracing photons...\n");
 		renderPhotons();
-		printf("Blurring photon maps...\n");
-		blurPhotonMaps();
+		printf("Baking photon maps...\n");
+		bakePhotonMaps();
 	}
 	
 	for (int i = 0; i < (int)objects.size(); ++i)
@@ -660,7 +939,7 @@ void Scene::writePhotonMaps(const std::string& filename)
 	}
 }
 
-void Scene::saveImage(const std::string& filename, const Image &img, const Image &depthImg, unsigned int factor)
+void Scene::saveImage(const std::string& filename, const std::vector<PixelStats> &pixels, unsigned int factor)
 {
 	char outputFilename[256];
 	sprintf(outputFilename, "%s-%u.png", filename.c_str(), factor);
@@ -669,12 +948,12 @@ void Scene::saveImage(const std::string& filename, const Image &img, const Image
 	
 	for (int y=0; y<camera.viewHeight; y++)
 		for (int x=0; x<camera.viewWidth; x++)
-			outputImage(x, y) = img(x, y) / depthImg(x, y).r;
+			outputImage(x, y) = pixels[y*camera.viewWidth + x].mean;
 
 	outputImage.write_png(outputFilename);
 }
 
-void Scene::saveDepthImage(const std::string& filename, const Image &img, unsigned int nPoints)
+void Scene::saveDepthImage(const std::string& filename, const std::vector<PixelStats> &pixels, unsigned int nPoints)
 {
 	char outputFilename[256];
 	sprintf(outputFilename, "%s-depth.png", filename.c_str());
@@ -682,8 +961,13 @@ void Scene::saveDepthImage(const std::string& filename, const Image &img, unsign
 	Image outputImage(camera.viewWidth, camera.viewHeight);
 	
 	for (int y=0; y<camera.viewHeight; y++)
+	{
 		for (int x=0; x<camera.viewWidth; x++)
-			outputImage(x, y) = img(x, y) / nPoints;
+		{
+			double count = pixels[y*camera.viewWidth + x].count;
+			outputImage(x, y) = Color(count, count, count) / nPoints;
+		}
+	}
 
 	outputImage.write_png(outputFilename);
 }
@@ -698,43 +982,82 @@ void Scene::render(const std::string& filename)
 	Vector xvec = (camera.center-camera.eye).normalized().cross(camera.up);
 	Vector yvec = -camera.up;
 	
-	// init random generator
-	srand(time(NULL));
+	printf("Random seed: %llu\n", (unsigned long long)seed);
+	Stats::reset();
 	
+	buildBVH();
 	computeGlobalAmbient();
+	initOcclusionCache();
 	
 	if (photonFactor > 0)
 	{
 		printf("Tracing photons...\n");
 		renderPhotons();
-		printf("Blurring photon maps...\n");
-		blurPhotonMaps();
 	}
 	
 	
-	unsigned int factor = min(superSamplingMinFactor, superSamplingFactor);
-	if (factor < 1) factor = 1;
-	unsigned int nPoints = 0;
+	unsigned int firstFactor = min(superSamplingMinFactor, superSamplingFactor);
+	if (firstFactor < 1) firstFactor = 1;
+	unsigned int factor = firstFactor, nPoints = 0;
+	
+	// Samples per pixel if every pass ran, however far the image converges
+	unsigned int scheduledPoints = 0;
+	for (unsigned int f = firstFactor; scheduledPoints < superSamplingTotal; f *= 2)
+		scheduledPoints += f*f;
 	
-	Image img(camera.viewWidth, camera.viewHeight);
-	Image depthImg(camera.viewWidth, camera.viewHeight);
-	Image variance(camera.viewWidth, camera.viewHeight);
+	int numPixels = camera.viewWidth*camera.viewHeight;
+	std::vector<PixelStats> pixels(numPixels);
+	// Pixels in every tile that still need samples
+	std::vector<int> unconverged(TileScheduler::countTiles(camera.viewWidth, camera.viewHeight, tileSize), 1);
 	
 	while (nPoints < superSamplingTotal)
 	{
 		printf("Tracing %ux%u...\n", factor, factor);
-		renderPass(img, depthImg, variance, xvec, yvec, nPoints, factor);
+		renderPass(pixels, unconverged, xvec, yvec, nPoints, factor);
+		// The next pass can use the occlusion samples of all threads
+		for (unsigned int i = 0; i < ambientThreadCaches.size(); i++)
+			ambientCache.merge(&ambientThreadCaches[i]);
 		nPoints += factor*factor;
-		if (mode == passes) saveImage(filename, img, depthImg, factor);
+		if (mode == passes) saveImage(filename, pixels, factor);
 		factor *= 2;
+		
+		long long left = 0;
+		for (unsigned int i = 0; i < unconverged.size(); i++)
+			left += unconverged[i];
+		printf("%.2f%% of pixels not converged\n", 100.0*left/numPixels);
+		if (nPoints < superSamplingTotal && left <= superSamplingStopFraction*numPixels)
+		{
+			printf("Stopping early\n");
+			break;
+		}
 	}
 	
-	if (mode != passes && mode != ssdepth) saveImage(filename, img, depthImg, 0);
-	if (mode == passes || mode == ssdepth) saveDepthImage(filename, depthImg, nPoints*2);
+	if (mode != passes && mode != ssdepth) saveImage(filename, pixels, 0);
+	if (mode == passes || mode == ssdepth) saveDepthImage(filename, pixels, scheduledPoints*2);
+	
+	double samples = 0.0;
+	for (int i = 0; i < numPixels; i++)
+		samples += pixels[i].count;
 	
 	time(&end);
 	
 	printf("\nTotal time: %.0lf seconds.\n", difftime(end, start));
+	
+	unsigned long shaded = Stats::get(Stats::shadedSamples), trig = Stats::get(Stats::trigCalls);
+	unsigned long secondary = Stats::get(Stats::secondaryRays), ambientRays = Stats::get(Stats::ambientRays);
+	printf("Camera samples: %.0f (%.2f per pixel), %.1f%% of the %.0f of all passes\n",
+		samples, samples/numPixels, 100.0*samples/((double)scheduledPoints*numPixels), (double)scheduledPoints*numPixels);
+	printf("Shaded samples: %lu, trig calls: %lu (%.2f per sample), secondary rays: %lu (%.2f per sample)\n",
+		shaded, trig, shaded > 0 ? (double)trig/shaded : 0.0, secondary, shaded > 0 ? (double)secondary/shaded : 0.0);
+	if (ambientFactor > 0)
+		printf("Ambient occlusion rays: %lu (%.2f per pixel)\n",
+			ambientRays, (double)ambientRays/(camera.viewWidth*camera.viewHeight));
+	if (ambientFactor > 0 && ambientCacheError > 0.0)
+	{
+		unsigned long hits = Stats::get(Stats::ambientCacheHits), misses = Stats::get(Stats::ambientCacheMisses);
+		printf("Ambient occlusion cache: %u samples, %.1f%% of lookups interpolated\n",
+			ambientCache.size(), hits + misses > 0 ? 100.0*hits/(hits + misses) : 0.0);
+	}
 }
 
 void Scene::addObject(Object *o)
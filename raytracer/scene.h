@@ -25,75 +25,103 @@
 #include "light.h"
 #include "object.h"
 #include "image.h"
+#include "texture.h"
 #include "camera.h"
+#include "bvh.h"
+#include "primitivestore.h"
+#include "random.h"
+#include "photonmap.h"
+#include "occlusioncache.h"
+#include "sampler.h"
+#include "pixelstats.h"
 
 class Scene
 {
 private:
 	std::vector<Object*> objects;
 	std::vector<Light*> lights;
+	std::vector<Object*> unboundedObjects, lightObjects; // objects intersectRay() doesn't find through the BVH
+	BVH bvh;
+	PrimitiveStore primitives; // the objects in the BVH, in its order
 	Camera camera;
 	bool shadows;
 	unsigned int maxRecursionDepth;
 	double minRecursionWeight;
+	bool russianRoulette; // trace one of the reflected and refracted rays, see reflectRefract()
 	unsigned int superSamplingFactor, superSamplingTotal, superSamplingMinFactor;
 	double superSamplingThreshold, superSamplingThresholdSquared;
+	double superSamplingStopFraction; // stop once no more than this part of the pixels needs samples
 	bool superSamplingJitter;
+	bool lowDiscrepancy; // take camera rays from a Sampler instead of the nested grids
+	int tileSize;
 	Color globalAmbient;
 	double goochB, goochY, goochAlpha, goochBeta;
 	double edges;
 	int photonFactor, photonBlur;
 	double photonIntensity;
+	PhotonMap photonMap;
 	unsigned int ambientFactor;
+	uint64_t seed;
 	double ambientRandom;
+	double ambientDistance; // blockers further away than this don't occlude, see occlusion()
+	double ambientCacheError; // OcclusionCache::clear(), 0 to cast rays at every point
+	double ambientMinRadius, ambientMaxRadius;
+	OcclusionCache ambientCache;
+	std::vector<OcclusionCache> ambientThreadCaches; // samples added by each thread during a pass
+	double pixelSpread; // width of the area a primary ray sample covers, per unit of distance
 	
-	Color calcPhong(Object *obj, Point *hit, Vector *N, Vector *V, unsigned int recursionDepth, double recursionWeight);
-	Color calcGooch(Object *obj, Point *hit, Vector *N, Vector *V, unsigned int recursionDepth, double recursionWeight);
+	Color calcPhong(SurfaceInteraction *si, Vector *V, unsigned int recursionDepth, double recursionWeight, Random *rng);
+	Color calcGooch(SurfaceInteraction *si, Vector *V, unsigned int recursionDepth, double recursionWeight, Random *rng);
 	
 	inline Color backgroundColor(const Vector *V);
 	inline Vector reflectVector(Vector *N, Vector *V);
-	inline void reflect(Color *color, Object *obj, Point *hit, Vector *N, Vector *V, double ks, unsigned int recursionDepth, double recursionWeight);
-	inline Vector refractVector(Object *obj, Point *hit, Vector *N, Vector *V, double nOut, double nIn);
-	inline void refract(Color *color, Object *obj, Point *hit, Vector *N, Vector *V, unsigned int recursionDepth, double recursionWeight);
-	inline bool shadowed(Object *obj, Light *light, Vector *L);
-	inline void diffusePhong(Color *color, Object *obj, Point *hit, Light *light, Vector *L, Vector *N);
-	inline void diffuseGooch(Color *color, Object *obj, Point *hit, Light *light, Vector *L, Vector *N, Vector *V);
+	inline void reflect(Color *color, Object *obj, Point *hit, Vector *N, Vector *V, double ks, unsigned int recursionDepth, double recursionWeight, Random *rng);
+	inline Vector refractVector(bool entering, Vector *N, Vector *V, double nOut, double nIn);
+	inline void refract(Color *color, Object *obj, Point *hit, Vector *N, Vector *V, bool entering, unsigned int recursionDepth, double recursionWeight, Random *rng);
+	inline void reflectRefract(Color *color, SurfaceInteraction *si, Vector *V, double ks, unsigned int recursionDepth, double recursionWeight, Random *rng);
+	inline bool shadowed(Object *obj, Point *hit, Light *light, Vector *L);
+	inline void diffusePhong(Color *color, Object *obj, Color *objColor, Light *light, Vector *L, Vector *N);
+	inline void diffuseGooch(Color *color, Object *obj, Color *objColor, Light *light, Vector *L, Vector *N, Vector *V);
 	inline void specular(Color *color, Object *obj, Light *light, Vector *L, Vector *N, Vector *V, double ks);
-	inline void ambient(Color *color, Object *obj, Point *hit, Vector *N);
+	inline void ambient(Color *color, Object *obj, Color *objColor, Point *hit, Vector *N, Random *rng);
+	inline double occlusion(Point *hit, Vector *N, Random *rng, double *radius);
+	inline double cachedOcclusion(Point *hit, Vector *N, Random *rng);
 	inline bool edgeDetection(Color *color, Vector *N, Vector *V);
 	inline Vector lightVector(Point *hit, Light *light);
-	inline void photons(Color *color, Object *obj, Point *hit);
-	inline void darkmap(Color *color, Object *obj, Point *hit);
+	inline void photons(Color *color, SurfaceInteraction *si, Vector *V);
+	inline void darkmap(Color *color, SurfaceInteraction *si);
 	
-	inline Color anaglyphRay(Point pixel, Point eye);
-	inline Color exposureRay(Point pixel, Point eye);
-	inline Color apertureRay(Vector pixel, unsigned int subpixel);
-	Hit intersectRay(const Ray &ray, bool closest, double maxT, bool traceLights);
+	inline Color anaglyphRay(Point pixel, Point eye, Random *rng);
+	inline Color exposureRay(Point pixel, Point eye, Random *rng);
+	inline Color apertureRay(Vector pixel, unsigned int subpixel, Random *rng);
+	inline Color sampledRay(Point pixel, Vector xvec, Vector yvec, const Sampler *sampler, unsigned int i, Random *rng);
+	Hit intersectRay(const Ray &ray, bool closest, double maxT, bool traceLights, Object *ignore = NULL);
+	void buildBVH();
 	void computeGlobalAmbient();
+	void initOcclusionCache();
 	
-	void tracePhoton(Color color, const Ray &ray, unsigned int recursionDepth, double recursionWeight, Object *onlyObject);
-	void renderPhotonsForLightAndObject(Light *light, Object *obj);
-	void renderPhotonsForLight(Light *light);
+	void tracePhoton(Color color, const Ray &ray, unsigned int recursionDepth, double recursionWeight, Object *onlyObject, std::vector<Photon> *store);
+	void renderPhotonRow(Light *light, Object *obj, int y, std::vector<Photon> *store);
 	void renderPhotons();
-	void blurPhotonMaps();
+	void bakePhotonMaps();
 	
-	void superSampleRay(Color * totalCol, double * variance, unsigned int nPoints, Point origPixel, Vector xvec, Vector yvec, unsigned int factor);
-	void renderPass(Image &img, Image &depthImg, Image &variance, Vector xvec, Vector yvec, unsigned int nPoints, unsigned int factor);
-	void saveImage(const std::string& filename, const Image &img, const Image &depthImg, unsigned int factor);
-	void saveDepthImage(const std::string& filename, const Image &img, unsigned int nPoints);
+	void superSampleRay(PixelStats *stats, unsigned int nPoints, Point origPixel, Vector xvec, Vector yvec, unsigned int factor, const Sampler *sampler, Random *rng);
+	void renderPass(std::vector<PixelStats> &pixels, std::vector<int> &unconverged, Vector xvec, Vector yvec, unsigned int nPoints, unsigned int factor);
+	void saveImage(const std::string& filename, const std::vector<PixelStats> &pixels, unsigned int factor);
+	void saveDepthImage(const std::string& filename, const std::vector<PixelStats> &pixels, unsigned int nPoints);
 	
 public:	
 	enum RenderMode {
 		phong, zbuffer, normal, texcoords, gooch, ssdepth, photon, passes
 	} mode;
 	
-	Image *background;
+	Texture *background;
 	
-	Scene() { background = NULL; }
-	~Scene() { if (background) delete background; }
+	Scene() { background = NULL; tileSize = 16; seed = 0; pixelSpread = 0.0; russianRoulette = false; lowDiscrepancy = false; superSamplingStopFraction = 0.0; }
+	~Scene() { if (background) background->release(); }
 	
 	void writePhotonMaps(const std::string& filename);
-	Color trace(const Ray &ray, unsigned int recursionDepth, double recursionWeight, bool traceLights);
+	Color trace(const Ray &ray, unsigned int recursionDepth, double recursionWeight, bool traceLights, Random *rng);
 	void render(const std::string& filename);
 	void addObject(Object *o);
 	void addLight(Light *l);
@@ -103,15 +131,23 @@ public:
 	void setSuperSampling(unsigned int f, unsigned int fmin, double threshold, bool jitter)
 	{ superSamplingFactor = f; superSamplingMinFactor = fmin; superSamplingTotal = f*f; superSamplingThreshold = threshold; 
 	superSamplingJitter = jitter; superSamplingThresholdSquared = threshold*threshold; }
+	void setLowDiscrepancy(bool b) { lowDiscrepancy = b; }
+	void setSuperSamplingStopFraction(double f) { superSamplingStopFraction = f; }
+	void setTileSize(unsigned int s) { tileSize = (int)s; }
 	void setRenderMode(Scene::RenderMode m) { mode = m; }
 	void setShadows(bool b) { shadows = b; }
 	void setEdges(double e) { edges = e; }
 	void setMaxRecursionDepth(unsigned int d) { maxRecursionDepth = d; }
 	void setMinRecursionWeight(double w) { minRecursionWeight = w; }
+	void setRussianRoulette(bool b) { russianRoulette = b; }
 	void setPhotonFactor(unsigned int f) { photonFactor = (int)f; }
 	void setPhotonBlur(unsigned int b) { photonBlur = (int)b; }
 	void setPhotonIntensity(double i) { photonIntensity = i; }
-	void setAmbient(unsigned int f, double r) { ambientFactor = f; ambientRandom = r; }
+	void setPhotonNeighbours(unsigned int n) { photonMap.setNeighbours(n); }
+	void setPhotonRadius(double r) { photonMap.setMaxDistance(r); }
+	void setAmbient(unsigned int f, double r, double d, double cacheError)
+	{ ambientFactor = f; ambientRandom = r; ambientDistance = d; ambientCacheError = cacheError; }
+	void setSeed(uint64_t s) { seed = s; }
 	unsigned int getNumObjects() { return objects.size(); }
 	unsigned int getNumLights() { return lights.size(); }
 	void setGoochParameters(double b, double y, double alpha, double beta)
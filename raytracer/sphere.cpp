@@ -17,6 +17,7 @@
 //    Jan Paul Posma
 
 #include "sphere.h"
+#include "stats.h"
 #include <iostream>
 #include <math.h>
 #include <vector>
@@ -24,6 +25,11 @@
 /************************** Sphere **********************************/
 
 Hit Sphere::intersect(const Ray &ray, bool closest, double maxT)
+{
+	return intersect(position, r, ray, this);
+}
+
+Hit Sphere::intersect(const Point &position, double r, const Ray &ray, Object *obj)
 {
 	/* t = (l . c) +/- sqrt( (l . c)^2 - c^2 + r^2 )
 	 * Formula and derivation found at https://secure.wikimedia.org/wikipedia/en/wiki/Line%E2%80%93sphere_intersection
@@ -63,15 +69,35 @@ Hit Sphere::intersect(const Ray &ray, bool closest, double maxT)
 		N = -N;
 	}
 
-	return Hit(t,N, this);
+	return Hit(t,N, obj, t1 >= 0);
+}
+
+void Sphere::getSpans(const Ray &ray, SpanList *spans)
+{
+	// Same formula as intersect(), but the ray is inside the sphere
+	// between the two solutions
+	Vector CO = position - ray.O;
+	double DdotCO = ray.D.dot(CO);
+	double inRoot = DdotCO * DdotCO - CO.length_2() + r*r;
+	if (inRoot < 0)
+		return;
+	double t1 = DdotCO - sqrt(inRoot);
+	double t2 = DdotCO + sqrt(inRoot);
+	
+	Span span;
+	span.in = Hit(t1, (ray.at(t1) - position).normalized(), this, true);
+	span.out = Hit(t2, (position - ray.at(t2)).normalized(), this, false);
+	spans->push_back(span);
 }
 
 void Sphere::getTexCoords(const Point &p, double &u, double &v)
 {
-	// Texture mapping for spheres. Formulas from Fundamentals of CG p. 251
-	Point pr = unRotate(p);
-	double theta = acos((pr.z - position.z)/r);
-	double phi = atan2(pr.y - position.y, pr.x - position.x)/* - (angle*M_PI/180.0)*/;
+	// Texture mapping for spheres. Formulas from Fundamentals of CG p. 251,
+	// on the unit sphere the sphere is in its own space
+	Point d = getWorldToObject().apply(p);
+	Stats::add(Stats::trigCalls, 2);
+	double theta = acos(fmax(-1.0, fmin(1.0, d.z)));
+	double phi = atan2(d.y, d.x);
 	while (phi < 0.0)
 		phi += 2*M_PI;
 	u = phi/(2*M_PI);
@@ -83,11 +109,23 @@ Point Sphere::getPointFromTexCoords(double u, double v)
 {
 	double phi = u*2*M_PI;
 	double theta = v*M_PI;
+	Stats::add(Stats::trigCalls, 4);
 	if (phi > M_PI)
 		phi -= 2*M_PI;
-	return rotate(Point(
-		position.x + r*cos(phi)*sin(theta),
-		position.y + r*sin(phi)*sin(theta),
-		position.z + r*cos(theta)
-	));
+	return getObjectToWorld().apply(Point(cos(phi)*sin(theta), sin(phi)*sin(theta), cos(theta)));
+}
+
+bool Sphere::getTexDerivatives(const Point &p, double u, double v, Vector *dpdu, Vector *dpdv)
+{
+	// Derivatives of getPointFromTexCoords(). They are written in terms of
+	// the direction d = (cos phi sin theta, sin phi sin theta, cos theta)
+	// from the center to the point, so no trig functions are needed.
+	Point d = getWorldToObject().apply(p);
+	double sinTheta = sqrt(d.x*d.x + d.y*d.y);
+	if (sinTheta < 1e-9)
+		// At the poles u doesn't move the point at all
+		return false;
+	*dpdu = getObjectToWorld().applyDirection(2*M_PI*Vector(-d.y, d.x, 0));
+	*dpdv = getObjectToWorld().applyDirection(M_PI*Vector(d.x*d.z/sinTheta, d.y*d.z/sinTheta, -sinTheta));
+	return true;
 }
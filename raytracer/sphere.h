@@ -25,18 +25,30 @@
 class Sphere : public Object
 {
 public:
-	Sphere(Point position, double r, const Vector &rot, double angle) : Object(rot, angle), position(position), r(r) { }
-	Sphere(Point position, double r) : Object(Vector(0, 0, 1), 0.0), position(position), r(r) { }
+	Sphere(Point position, double r, const Vector &rot, double angle) : Object(rot, angle), position(position), r(r) { init(); }
+	Sphere(Point position, double r) : Object(Vector(0, 0, 1), 0.0), position(position), r(r) { init(); }
 
 	virtual Hit intersect(const Ray &ray, bool closest, double maxT);
+	/**
+	 * Intersect a ray with the sphere with the given center and radius
+	 * @param obj Object the hit is reported for
+	 */
+	static Hit intersect(const Point &position, double r, const Ray &ray, Object *obj);
+	virtual void getSpans(const Ray &ray, SpanList *spans);
 	virtual Point getRotationCenter() { return position; }
 	virtual void getTexCoords(const Point &p, double &x, double &y);
 	virtual Point getPointFromTexCoords(double u, double v);
+	virtual bool getTexDerivatives(const Point &p, double u, double v, Vector *dpdu, Vector *dpdv);
+	virtual AABB getBounds() { return AABB(position - r, position + r); }
 
 	const Point position;
 	const double r;
 	
 	double getRadius() { return r; };
+
+private:
+	// The sphere's own space is the unit sphere, with the rotation undone
+	void init() { setTransform(Transform(rotation*Matrix::scale(r), position)); }
 };
 
 #endif /* end of include guard: SPHERE_H_115209AE */
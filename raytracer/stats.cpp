@@ -0,0 +1,39 @@
+//
+//  Framework for a raytracer
+//  File: stats.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "stats.h"
+
+std::vector<Stats::Slot> Stats::slots;
+Stats::Slot Stats::shared;
+
+unsigned long Stats::get(Counter c)
+{
+	unsigned long total = shared.count[c];
+	for (unsigned int i = 0; i < slots.size(); i++)
+		total += slots[i].count[c];
+	return total;
+}
+
+void Stats::reset()
+{
+	// Must not be called while threads are counting
+	slots.resize(omp_get_max_threads());
+	for (unsigned int i = 0; i < slots.size(); i++)
+		for (int c = 0; c < numCounters; c++)
+			slots[i].count[c] = 0;
+	for (int c = 0; c < numCounters; c++)
+		shared.count[c] = 0;
+}
@@ -0,0 +1,72 @@
+//
+//  Framework for a raytracer
+//  File: stats.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <vector>
+#include <omp.h>
+
+// Size of a cache line, to keep data of different threads apart
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+/**
+ * Counts how often things happen while rendering, to see where the time
+ * goes. Every thread counts in a slot of its own, so counting doesn't
+ * make the threads wait for each other. reset() makes a slot for every
+ * thread OpenMP may start; any threads beyond those count atomically in
+ * a shared slot.
+ */
+class Stats
+{
+public:
+	enum Counter {
+		shadedSamples, // ray hits that were shaded
+		trigCalls,     // trigonometric functions called for texture coordinates
+		secondaryRays, // reflected and refracted rays traced
+		ambientRays,   // ambient occlusion rays traced
+		ambientCacheHits,   // ambient occlusion interpolated from the cache
+		ambientCacheMisses, // ambient occlusion computed because the cache had none
+		numCounters
+	};
+
+	static void add(Counter c, unsigned long n = 1)
+	{
+		unsigned int thread = omp_get_thread_num();
+		if (thread < slots.size()) {
+			slots[thread].count[c] += n;
+		} else {
+			#pragma omp atomic
+				shared.count[c] += n;
+		}
+	}
+	// Total of all threads
+	static unsigned long get(Counter c);
+	static void reset();
+
+private:
+	struct Slot
+	{
+		unsigned long count[numCounters];
+		char padding[CACHE_LINE_SIZE];
+	};
+	static std::vector<Slot> slots;
+	static Slot shared;
+};
+
+#endif /* end of include guard: STATS_H */
@@ -0,0 +1,46 @@
+//
+//  Framework for a raytracer
+//  File: surfaceinteraction.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef SURFACEINTERACTION_H
+#define SURFACEINTERACTION_H
+
+#include "triple.h"
+#include "texture.h"
+
+class Object;
+
+/**
+ * Everything shading needs to know about the point a ray hit. It is
+ * filled in once per hit by Object::getSurfaceInteraction(), so the
+ * texture coordinates and the bumped normal are only computed once, no
+ * matter how many lights and textures look at them.
+ */
+struct SurfaceInteraction
+{
+	Object *obj;
+	Point p;          // hit point
+	Vector Ng;        // normal of the surface itself
+	Vector N;         // normal used for shading, interpolated and bump mapped
+	bool entering;    // see Hit::entering
+	bool hasTexCoords;
+	double u, v;      // texture coordinates, only set if hasTexCoords
+	// How p moves with u and v, only set if the object could tell
+	bool hasDerivatives;
+	Vector dpdu, dpdv;
+	TexFootprint fp;  // part of the textures the sample covers
+};
+
+#endif /* end of include guard: SURFACEINTERACTION_H */
@@ -0,0 +1,246 @@
+//
+//  Framework for a raytracer
+//  File: texture.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "texture.h"
+#include "lodepng.h"
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <math.h>
+
+using namespace std;
+
+TextureCache::Map TextureCache::textures;
+
+Texture::Texture(const std::string &filename, Format format)
+	: filename(filename), format(format), channels(format == RGBA8 ? 4 : 3), refs(1)
+{
+}
+
+void Texture::load()
+{
+	if (isLoaded())
+		return;
+	read_png();
+	buildMipmaps();
+	printf("Texture %s: %dx%d, %d mipmaps, %lu kB\n", filename.c_str(), width(), height(),
+		getNumLevels(), (unsigned long)(getMemorySize()/1024));
+}
+
+void Texture::read_png()
+{
+	std::vector<unsigned char> buffer, image;
+	LodePNG::loadFile(buffer, filename);
+
+	LodePNG::Decoder decoder;
+	decoder.inspect(buffer);
+	// 16 bit images are kept as they are for RGB16 textures, everything
+	// else is converted to 8 bit RGBA by the decoder
+	bool wide = format == RGB16 && !decoder.hasError() && decoder.getInfoPng().color.bitDepth == 16;
+	if (wide) {
+		decoder.getInfoRaw().color.colorType = decoder.getInfoPng().color.colorType;
+		decoder.getInfoRaw().color.bitDepth = 16;
+	}
+	decoder.decode(image, buffer);
+	if (decoder.hasError() || buffer.empty()) {
+		cerr << "Error: unable to read texture " << filename << " (error " << decoder.getError() << ")." << endl;
+		exit(1);
+	}
+
+	Level level;
+	level.width = decoder.getWidth();
+	level.height = decoder.getHeight();
+	level.offset = 0;
+	levels.push_back(level);
+
+	size_t n = (size_t)level.width*level.height;
+	if (format == RGBA8) {
+		texels8.swap(image);
+		return;
+	}
+
+	int imageChannels = wide ? decoder.getChannels() : 4;
+	texels16.resize(n*3);
+	for (size_t i = 0; i < n; i++) {
+		for (int c = 0; c < 3; c++) {
+			// Grey images have the same value in every channel
+			int from = imageChannels < 3 ? 0 : c;
+			if (wide) {
+				// 16 bit values are stored big endian
+				const unsigned char *p = &image[(i*imageChannels + from)*2];
+				texels16[i*3 + c] = (unsigned short)((p[0] << 8) | p[1]);
+			} else {
+				texels16[i*3 + c] = (unsigned short)(image[i*4 + from]*257);
+			}
+		}
+	}
+}
+
+// Make a mipmap half the size of the one before it, averaging blocks of 2x2 texels
+template <class T>
+static void downsample(T *texels, int channels, int srcWidth, int srcHeight, size_t src,
+	int dstWidth, int dstHeight, size_t dst)
+{
+	for (int y = 0; y < dstHeight; y++) {
+		int y0 = min(2*y, srcHeight - 1), y1 = min(2*y + 1, srcHeight - 1);
+		for (int x = 0; x < dstWidth; x++) {
+			int x0 = min(2*x, srcWidth - 1), x1 = min(2*x + 1, srcWidth - 1);
+			for (int c = 0; c < channels; c++) {
+				unsigned int sum = texels[src + (y0*srcWidth + x0)*channels + c]
+					+ texels[src + (y0*srcWidth + x1)*channels + c]
+					+ texels[src + (y1*srcWidth + x0)*channels + c]
+					+ texels[src + (y1*srcWidth + x1)*channels + c];
+				texels[dst + (y*dstWidth + x)*channels + c] = (T)((sum + 2)/4);
+			}
+		}
+	}
+}
+
+void Texture::buildMipmaps()
+{
+	// Lay out all levels first, so the storage only grows once
+	size_t total = (size_t)width()*height()*channels;
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		Level level;
+		level.width = max(1, levels.back().width/2);
+		level.height = max(1, levels.back().height/2);
+		level.offset = total;
+		total += (size_t)level.width*level.height*channels;
+		levels.push_back(level);
+	}
+
+	if (format == RGBA8)
+		texels8.resize(total);
+	else
+		texels16.resize(total);
+
+	for (unsigned int i = 1; i < levels.size(); i++) {
+		const Level &src = levels[i - 1], &dst = levels[i];
+		if (format == RGBA8)
+			downsample(&texels8[0], channels, src.width, src.height, src.offset, dst.width, dst.height, dst.offset);
+		else
+			downsample(&texels16[0], channels, src.width, src.height, src.offset, dst.width, dst.height, dst.offset);
+	}
+}
+
+inline void Texture::texel(const Level &l, int x, int y, float *rgb) const
+{
+	size_t i = l.offset + (size_t)(y*l.width + x)*channels;
+	if (format == RGBA8) {
+		for (int c = 0; c < 3; c++)
+			rgb[c] = texels8[i + c]*(1.0f/255.0f);
+	} else {
+		for (int c = 0; c < 3; c++)
+			rgb[c] = texels16[i + c]*(1.0f/65535.0f);
+	}
+}
+
+void Texture::bilinear(int level, double u, double v, float *rgb) const
+{
+	const Level &l = levels[level];
+	// u wraps around, like it does on the seam of a sphere, but v stops
+	// at the edges
+	double x = floor(u*(l.width - 1));
+	double y = min(max(v, 0.0), 1.0)*(l.height - 1);
+	int x0 = (int)fmod(x, (double)l.width), y0 = (int)y;
+	if (x0 < 0)
+		x0 += l.width;
+	int x1 = (x0 + 1) % l.width, y1 = min(y0 + 1, l.height - 1);
+	float fx = (float)(u*(l.width - 1) - x), fy = (float)(y - y0);
+
+	float a[3], b[3], c[3], d[3];
+	texel(l, x0, y0, a);
+	texel(l, x1, y0, b);
+	texel(l, x0, y1, c);
+	texel(l, x1, y1, d);
+	for (int i = 0; i < 3; i++)
+		rgb[i] = (a[i]*(1.0f - fx) + b[i]*fx)*(1.0f - fy) + (c[i]*(1.0f - fx) + d[i]*fx)*fy;
+}
+
+void Texture::trilinear(double level, double u, double v, float *rgb) const
+{
+	int l0 = (int)level;
+	float f = (float)(level - l0);
+	if (l0 >= getNumLevels() - 1 || f <= 0.0f) {
+		bilinear(min(l0, getNumLevels() - 1), u, v, rgb);
+		return;
+	}
+
+	float next[3];
+	bilinear(l0, u, v, rgb);
+	bilinear(l0 + 1, u, v, next);
+	for (int i = 0; i < 3; i++)
+		rgb[i] += (next[i] - rgb[i])*f;
+}
+
+double Texture::getLevel(const TexFootprint &fp) const
+{
+	// Number of full size texels the footprint spans; every mipmap
+	// level halves it
+	double texels = max(fp.du*(width() - 1), fp.dv*(height() - 1));
+	if (texels <= 1.0)
+		return 0.0;
+	return min(log2(texels), (double)(getNumLevels() - 1));
+}
+
+Color Texture::colorAt(double u, double v) const
+{
+	float rgb[3];
+	bilinear(0, u, v, rgb);
+	return Color(rgb[0], rgb[1], rgb[2]);
+}
+
+Color Texture::colorAt(double u, double v, const TexFootprint &fp) const
+{
+	float rgb[3];
+	trilinear(getLevel(fp), u, v, rgb);
+	return Color(rgb[0], rgb[1], rgb[2]);
+}
+
+void Texture::derivativeAt(double u, double v, const TexFootprint &fp, float *dx, float *dy) const
+{
+	double level = getLevel(fp);
+	float here[3], down[3], right[3];
+	trilinear(level, u, v, here);
+	trilinear(level, u, v + 1.0/max(height() - 1, 1), down);
+	trilinear(level, u + 1.0/max(width() - 1, 1), v, right);
+	*dx = down[1] - here[1];
+	*dy = right[1] - here[1];
+}
+
+Texture *TextureCache::get(const std::string &filename, Texture::Format format)
+{
+	std::pair<std::string, Texture::Format> key(filename, format);
+	Texture *&texture = textures[key];
+	if (!texture)
+		texture = new Texture(filename, format);
+	texture->acquire();
+	return texture;
+}
+
+void TextureCache::load()
+{
+	std::vector<Texture*> todo;
+	for (Map::iterator it = textures.begin(); it != textures.end(); ++it)
+		if (!it->second->isLoaded())
+			todo.push_back(it->second);
+
+	// Every file is decoded on its own, by whichever thread is free
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int)todo.size(); i++)
+		todo[i]->load();
+}
@@ -0,0 +1,132 @@
+//
+//  Framework for a raytracer
+//  File: texture.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <stddef.h>
+#include "triple.h"
+
+/**
+ * Size of the area a sample covers, in texture coordinates.
+ * Zero means the sample is a single point.
+ */
+struct TexFootprint
+{
+	double du, dv;
+	TexFootprint() : du(0.0), dv(0.0) { }
+};
+
+/**
+ * Read-only image used to color surfaces. Texels are stored in 8 bits
+ * per channel (RGBA8) or, for bump maps that need finer height steps, in
+ * 16 bits per channel (RGB16), instead of the floating point colors an
+ * Image uses. Halved copies of the texture (mipmaps) are made when it is
+ * loaded, so a sample covering many texels can be taken from a smaller
+ * copy instead of picking a single texel and aliasing.
+ * Texture coordinates run from 0 to 1, the first texel is at 0 and the
+ * last one at 1 as with Image::colorAt().
+ * Textures are shared by all objects that use the same file, see
+ * TextureCache. Every user holds a reference, and the texture is deleted
+ * once the last one is released.
+ */
+class Texture
+{
+public:
+	enum Format {
+		RGBA8, RGB16
+	};
+
+	// The file is read by load()
+	Texture(const std::string &filename, Format format = RGBA8);
+
+	void load();
+	bool isLoaded() const { return !levels.empty(); }
+	const std::string &getFilename() const { return filename; }
+
+	void acquire() { refs++; }
+	void release() { if (--refs == 0) delete this; }
+
+	// Bilinear sample of the full size texture
+	Color colorAt(double u, double v) const;
+	// Sample covering a footprint, blending the two nearest mipmaps (trilinear)
+	Color colorAt(double u, double v, const TexFootprint &fp) const;
+
+	/**
+	 * Height differences for bump mapping, using the green channel.
+	 * @param dx Height difference to the next texel in v direction
+	 * @param dy Height difference to the next texel in u direction
+	 */
+	void derivativeAt(double u, double v, const TexFootprint &fp, float *dx, float *dy) const;
+
+	int width() const { return levels[0].width; }
+	int height() const { return levels[0].height; }
+	int size() const { return width()*height(); }
+	int getNumLevels() const { return levels.size(); }
+	// Bytes used by the texels of all mipmaps
+	size_t getMemorySize() const { return texels8.size() + texels16.size()*sizeof(unsigned short); }
+
+private:
+	struct Level
+	{
+		int width, height;
+		size_t offset; // index of the first channel of the first texel
+	};
+
+	std::string filename;
+	Format format;
+	int channels;
+	int refs;
+	std::vector<Level> levels;
+	std::vector<unsigned char> texels8;
+	std::vector<unsigned short> texels16;
+
+	~Texture() { }
+
+	void read_png();
+	void buildMipmaps();
+	double getLevel(const TexFootprint &fp) const;
+	void bilinear(int level, double u, double v, float *rgb) const;
+	void trilinear(double level, double u, double v, float *rgb) const;
+	inline void texel(const Level &l, int x, int y, float *rgb) const;
+};
+
+/**
+ * All textures used by the scene, by file and format, so every file is
+ * only read and stored once. Files are not read when a texture is asked
+ * for, but all at the same time by load(), in parallel.
+ */
+class TextureCache
+{
+public:
+	/**
+	 * Get the texture for a file.
+	 * @return Texture holding a reference for the caller, which it has to release
+	 */
+	static Texture *get(const std::string &filename, Texture::Format format = Texture::RGBA8);
+	// Read all textures that haven't been read yet
+	static void load();
+
+private:
+	// The cache holds a reference to every texture, so they can be reused
+	typedef std::map<std::pair<std::string, Texture::Format>, Texture*> Map;
+	static Map textures;
+};
+
+#endif /* end of include guard: TEXTURE_H */
@@ -0,0 +1,129 @@
+//
+//  Framework for a raytracer
+//  File: tilescheduler.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "tilescheduler.h"
+#include <algorithm>
+
+TileScheduler::TileScheduler(int width, int height, int tileSize, int numThreads)
+	: width(width), height(height)
+{
+	if (tileSize < 1)
+		tileSize = 1;
+	if (numThreads < 1)
+		numThreads = 1;
+
+	// Row by row, so the tiles in a queue are close together
+	for (int y = 0; y < height; y += tileSize) {
+		for (int x = 0; x < width; x += tileSize) {
+			Tile tile;
+			tile.x0 = x;
+			tile.y0 = y;
+			tile.x1 = std::min(x + tileSize, width);
+			tile.y1 = std::min(y + tileSize, height);
+			tile.index = tiles.size();
+			tiles.push_back(tile);
+		}
+	}
+
+	// Give every thread an equal share
+	queues.resize(numThreads);
+	int n = tiles.size();
+	for (int i = 0; i < numThreads; i++) {
+		omp_init_lock(&queues[i].lock);
+		queues[i].first = (int)((long long)n*i/numThreads);
+		queues[i].last = (int)((long long)n*(i + 1)/numThreads);
+		queues[i].done = 0;
+	}
+}
+
+int TileScheduler::countTiles(int width, int height, int tileSize)
+{
+	if (tileSize < 1)
+		tileSize = 1;
+	return ((width + tileSize - 1)/tileSize)*((height + tileSize - 1)/tileSize);
+}
+
+TileScheduler::~TileScheduler()
+{
+	for (unsigned int i = 0; i < queues.size(); i++)
+		omp_destroy_lock(&queues[i].lock);
+}
+
+bool TileScheduler::next(int thread, Tile *tile)
+{
+	// Threads beyond the ones we planned for only steal
+	if (thread < (int)queues.size()) {
+		Queue &q = queues[thread];
+		omp_set_lock(&q.lock);
+		bool found = q.first < q.last;
+		if (found)
+			*tile = tiles[q.first++];
+		omp_unset_lock(&q.lock);
+		if (found)
+			return true;
+	}
+	return steal(thread, tile);
+}
+
+bool TileScheduler::steal(int thread, Tile *tile)
+{
+	int n = queues.size();
+	while (true)
+	{
+		// Rob the queue with the most work left. Its owner may take tiles
+		// before we get to it, so check again once the lock is taken.
+		int victim = -1, most = 0;
+		for (int i = 0; i < n; i++) {
+			omp_set_lock(&queues[i].lock);
+			int left = queues[i].last - queues[i].first;
+			omp_unset_lock(&queues[i].lock);
+			if (left > most) {
+				most = left;
+				victim = i;
+			}
+		}
+		if (victim < 0)
+			return false;
+
+		Queue &q = queues[victim];
+		omp_set_lock(&q.lock);
+		bool found = q.first < q.last;
+		if (found)
+			*tile = tiles[--q.last];
+		omp_unset_lock(&q.lock);
+		if (found)
+			return true;
+	}
+}
+
+void TileScheduler::addDone(int thread, int n)
+{
+	Queue &q = queues[thread % queues.size()];
+	#pragma omp atomic
+		q.done += n;
+}
+
+int TileScheduler::getDone()
+{
+	int done = 0;
+	for (unsigned int i = 0; i < queues.size(); i++) {
+		int d;
+		#pragma omp atomic read
+			d = queues[i].done;
+		done += d;
+	}
+	return done;
+}
@@ -0,0 +1,88 @@
+//
+//  Framework for a raytracer
+//  File: tilescheduler.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <vector>
+#include <omp.h>
+
+// Size of a cache line, to keep data of different threads apart
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+/**
+ * Rectangle of pixels x0 <= x < x1, y0 <= y < y1
+ */
+struct Tile
+{
+	int x0, y0, x1, y1;
+	int index; // the same in every scheduler for an image of the same size
+	int getNumPixels() const { return (x1 - x0)*(y1 - y0); }
+};
+
+/**
+ * Hands out the tiles of an image to a team of threads.
+ * Every thread starts out with a queue holding a block of neighbouring
+ * tiles, which it works through from the front. A thread whose queue is
+ * empty steals tiles from the back of the other queues, so expensive
+ * regions of the image get shared out instead of holding up the pass.
+ * Each thread also counts the pixels it has finished in a counter of its
+ * own; getDone() adds them up.
+ */
+class TileScheduler
+{
+public:
+	TileScheduler(int width, int height, int tileSize, int numThreads);
+	~TileScheduler();
+
+	/**
+	 * Get the next tile to render.
+	 * @param thread Number of the calling thread, as returned by omp_get_thread_num()
+	 * @param tile The tile is written here
+	 * @return False if all tiles have been handed out
+	 */
+	bool next(int thread, Tile *tile);
+
+	// Record that a thread finished n pixels
+	void addDone(int thread, int n);
+	// Number of pixels finished by all threads together
+	int getDone();
+
+	int getNumTiles() const { return tiles.size(); }
+	// Number of tiles a scheduler would cut an image into
+	static int countTiles(int width, int height, int tileSize);
+	int getNumPixels() const { return width*height; }
+
+private:
+	// The tiles a queue still holds are tiles[first .. last - 1]
+	struct Queue
+	{
+		omp_lock_t lock;
+		int first, last;
+		int done;
+		char padding[CACHE_LINE_SIZE];
+	};
+
+	int width, height;
+	std::vector<Tile> tiles;
+	std::vector<Queue> queues;
+
+	bool steal(int thread, Tile *tile);
+};
+
+#endif /* end of include guard: TILESCHEDULER_H */
@@ -0,0 +1,48 @@
+//
+//  Framework for a raytracer
+//  File: transform.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "triple.h"
+#include "matrix.h"
+
+/**
+ * Affine transformation p -> m*p + t. Objects use them to move points and
+ * directions between world space and their own space, see
+ * Object::setTransform(). Normals can be transformed with
+ * applyDirection() as long as m only rotates and scales uniformly.
+ */
+class Transform
+{
+public:
+	// The identity
+	Transform() { }
+	Transform(const Matrix &m, const Vector &t) : m(m), t(t) { }
+
+	Point apply(const Point &p) const { return m*p + t; }
+	Vector applyDirection(const Vector &v) const { return m*v; }
+	Transform inverse() const
+	{
+		Matrix mInv = m.inverse();
+		return Transform(mInv, -(mInv*t));
+	}
+
+	Matrix m;
+	Vector t;
+};
+
+#endif /* end of include guard: TRANSFORM_H */
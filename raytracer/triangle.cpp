@@ -3,34 +3,61 @@
 //    Jan Paul Posma
 
 #include "triangle.h"
+#include <algorithm>
 #include <iostream>
 #include <math.h>
 
 Hit Triangle::intersect(const Ray &ray, bool closest, double maxT)
 {
-	// algorithm of pages 206-208
-	double a, b, c, d, e, f, g, h, i, j, k, l, M, beta, gamma, t;
-	a = p1.x - p2.x; b = p1.y - p2.y; c = p1.z - p2.z;
-	d = p1.x - p3.x; e = p1.y - p3.y; f = p1.z - p3.z;
-	g = ray.D.x; h = ray.D.y; i = ray.D.z;
-	j = p1.x - ray.O.x; k = p1.y - ray.O.y; l = p1.z - ray.O.z;
+	double t;
+	if (!intersect(p1, p2, p3, ray, &t))
+		return Hit::NO_HIT();
 	
-	M = a*(e*i - h*f) + b*(g*f - d*i) + c*(d*h - e*g);
-	
-	t = -(f*(a*k - j*b) + e*(j*c - a*l) + d*(b*l - k*c))/M;
-	
-	if (t < 0) return Hit::NO_HIT();
-	
-	gamma = (i*(a*k - j*b) + h*(j*c - a*l) + g*(b*l - k*c))/M;
+	return Hit(t, normal(p1, p2, p3), this);
+}
+
+bool Triangle::intersect(const Point &p1, const Point &p2, const Point &p3, const Ray &ray, double *t,
+	double *betaOut, double *gammaOut)
+{
+	// Watertight test (Woop, Benthin and Wald, "Watertight Ray/Triangle
+	// Intersection"): the triangle is moved into a space where the ray
+	// starts at the origin and runs along the z axis, so whether it is hit
+	// follows from the signs of three 2D edge functions. Triangles that
+	// share an edge compute the same edge function with the opposite sign,
+	// so rays through the edge (or a vertex) never slip between them.
+	int kz = 0;
+	for (int k = 1; k < 3; k++)
+		if (fabs(ray.D.data[k]) > fabs(ray.D.data[kz]))
+			kz = k;
+	int kx = (kz + 1) % 3, ky = (kx + 1) % 3;
+	// Keep the winding of the triangle
+	if (ray.D.data[kz] < 0)
+		std::swap(kx, ky);
+	double Sx = ray.D.data[kx]/ray.D.data[kz], Sy = ray.D.data[ky]/ray.D.data[kz], Sz = 1.0/ray.D.data[kz];
 	
-	if (gamma < 0 || gamma > 1) return Hit::NO_HIT();
+	Vector A = p1 - ray.O, B = p2 - ray.O, C = p3 - ray.O;
+	double Ax = A.data[kx] - Sx*A.data[kz], Ay = A.data[ky] - Sy*A.data[kz];
+	double Bx = B.data[kx] - Sx*B.data[kz], By = B.data[ky] - Sy*B.data[kz];
+	double Cx = C.data[kx] - Sx*C.data[kz], Cy = C.data[ky] - Sy*C.data[kz];
 	
-	beta = (j*(e*i - h*f) + k*(g*f - d*i) + l*(d*h - e*g))/M;
+	// Edge functions of the edges opposite p1, p2 and p3
+	double U = Cx*By - Cy*Bx;
+	double V = Ax*Cy - Ay*Cx;
+	double W = Bx*Ay - By*Ax;
+	if ((U < 0 || V < 0 || W < 0) && (U > 0 || V > 0 || W > 0))
+		return false;
+	double det = U + V + W;
+	if (det == 0)
+		return false;
 	
-	if (beta < 0 || beta > (1 - gamma)) return Hit::NO_HIT();
+	double T = U*Sz*A.data[kz] + V*Sz*B.data[kz] + W*Sz*C.data[kz];
+	*t = T/det;
+	if (*t < 0) return false;
 	
-	Vector N = ((p2 - p1).cross(p3 - p1)).normalized();
-	return Hit(t, N, this);
+	double beta = V/det, gamma = W/det;
+	if (betaOut) *betaOut = beta;
+	if (gammaOut) *gammaOut = gamma;
+	return true;
 }
 
 Point Triangle::getRotationCenter()
@@ -41,6 +68,15 @@ Point Triangle::getRotationCenter()
 	return (p1 + p2 + p3)/3;
 }
 
+AABB Triangle::getBounds()
+{
+	AABB box;
+	box.extend(p1);
+	box.extend(p2);
+	box.extend(p3);
+	return box;
+}
+
 void Triangle::getTexCoords(const Point &p, double &u, double &v)
 {
 	// Use the dot product with vectors p2-p1 and p3-p1
@@ -29,8 +29,23 @@ public:
 	{ }
 
 	virtual Hit intersect(const Ray &ray, bool closest, double maxT);
+	
+	/**
+	 * Intersect a ray with the triangle (p1, p2, p3)
+	 * @param t If there is an intersection, its t value is written here
+	 * @param beta, gamma If not NULL, the barycentric coordinates of the
+	 *        intersection are written here: it lies at
+	 *        p1 + beta*(p2 - p1) + gamma*(p3 - p1)
+	 * @return Whether the ray intersects the triangle
+	 */
+	static bool intersect(const Point &p1, const Point &p2, const Point &p3, const Ray &ray, double *t,
+		double *beta = NULL, double *gamma = NULL);
+	static Vector normal(const Point &p1, const Point &p2, const Point &p3)
+	{ return ((p2 - p1).cross(p3 - p1)).normalized(); }
+	
 	virtual Point getRotationCenter();
 	virtual void getTexCoords(const Point &p, double &u, double &v);
+	virtual AABB getBounds();
 
 	Point p1, p2, p3;
 };
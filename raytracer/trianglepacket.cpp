@@ -0,0 +1,193 @@
+//
+//  Framework for a raytracer
+//  File: trianglepacket.cpp
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#include "trianglepacket.h"
+#include <float.h>
+#include <math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void TrianglePacket::clear()
+{
+	for (int lane = 0; lane < TRIANGLE_PACKET_WIDTH; lane++) {
+		for (int i = 0; i < 3; i++)
+			v0[i][lane] = e1[i][lane] = e2[i][lane] = 0.0f;
+		index[lane] = 0;
+	}
+}
+
+void TrianglePacket::set(int lane, const Point &p1, const Point &p2, const Point &p3, unsigned int idx)
+{
+	// Compute the edges in double precision, so triangles far away
+	// from the origin don't lose their shape
+	Vector edge1 = p2 - p1, edge2 = p3 - p1;
+	for (int i = 0; i < 3; i++) {
+		v0[i][lane] = (float)p1.data[i];
+		e1[i][lane] = (float)edge1.data[i];
+		e2[i][lane] = (float)edge2.data[i];
+	}
+	index[lane] = idx;
+}
+
+/*
+ * Moller-Trumbore ray-triangle intersection, for every lane:
+ *   P = D x e2, det = e1 . P
+ *   T = O - v0, u = (T . P)/det
+ *   Q = T x e1, v = (D . Q)/det, t = (e2 . Q)/det
+ * The ray hits if det != 0, u >= 0, v >= 0, u + v <= 1 and 0 <= t < maxT.
+ * All bounds are widened a little, see TRIANGLE_PACKET_EPSILON; the error
+ * in t grows with the distance between the ray origin and the triangle,
+ * which is estimated by |T|.
+ * Degenerate (unused) lanes have det == 0.
+ */
+
+// Upper bound on t, widened like the other bounds
+static inline float maxTLimit(float maxT)
+{
+	return maxT < FLT_MAX/2 ? maxT*(1.0f + TRIANGLE_PACKET_EPSILON) : FLT_MAX;
+}
+
+#if defined(__AVX__)
+
+int TrianglePacket::intersect(const PacketRay &ray, float maxT, float *t) const
+{
+	__m256 dx = _mm256_set1_ps(ray.D[0]), dy = _mm256_set1_ps(ray.D[1]), dz = _mm256_set1_ps(ray.D[2]);
+	__m256 e1x = _mm256_loadu_ps(e1[0]), e1y = _mm256_loadu_ps(e1[1]), e1z = _mm256_loadu_ps(e1[2]);
+	__m256 e2x = _mm256_loadu_ps(e2[0]), e2y = _mm256_loadu_ps(e2[1]), e2z = _mm256_loadu_ps(e2[2]);
+	__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	__m256 eps = _mm256_set1_ps(TRIANGLE_PACKET_EPSILON), signMask = _mm256_set1_ps(-0.0f);
+
+	__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+	__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+	__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+	__m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+	__m256 valid = _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ);
+	// Divide by 1 instead of 0 in invalid lanes
+	__m256 inv = _mm256_div_ps(one, _mm256_blendv_ps(one, det, valid));
+
+	__m256 tx = _mm256_sub_ps(_mm256_set1_ps(ray.O[0]), _mm256_loadu_ps(v0[0]));
+	__m256 ty = _mm256_sub_ps(_mm256_set1_ps(ray.O[1]), _mm256_loadu_ps(v0[1]));
+	__m256 tz = _mm256_sub_ps(_mm256_set1_ps(ray.O[2]), _mm256_loadu_ps(v0[2]));
+	__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)), _mm256_mul_ps(tz, pz)), inv);
+	__m256 minUV = _mm256_sub_ps(zero, eps);
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, minUV, _CMP_GE_OQ));
+
+	__m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+	__m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+	__m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+	__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inv);
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, minUV, _CMP_GE_OQ));
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_add_ps(one, eps), _CMP_LE_OQ));
+
+	__m256 tt = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inv);
+	__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(signMask, tx), _mm256_andnot_ps(signMask, ty)), _mm256_andnot_ps(signMask, tz));
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(tt, _mm256_sub_ps(zero, _mm256_mul_ps(eps, dist)), _CMP_GE_OQ));
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(tt, _mm256_set1_ps(maxTLimit(maxT)), _CMP_LT_OQ));
+
+	_mm256_storeu_ps(t, tt);
+	return _mm256_movemask_ps(valid);
+}
+
+#elif defined(__SSE2__)
+
+int TrianglePacket::intersect(const PacketRay &ray, float maxT, float *t) const
+{
+	__m128 dx = _mm_set1_ps(ray.D[0]), dy = _mm_set1_ps(ray.D[1]), dz = _mm_set1_ps(ray.D[2]);
+	__m128 e1x = _mm_loadu_ps(e1[0]), e1y = _mm_loadu_ps(e1[1]), e1z = _mm_loadu_ps(e1[2]);
+	__m128 e2x = _mm_loadu_ps(e2[0]), e2y = _mm_loadu_ps(e2[1]), e2z = _mm_loadu_ps(e2[2]);
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	__m128 eps = _mm_set1_ps(TRIANGLE_PACKET_EPSILON), signMask = _mm_set1_ps(-0.0f);
+
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 valid = _mm_cmpneq_ps(det, zero);
+	// Divide by 1 instead of 0 in invalid lanes
+	__m128 inv = _mm_div_ps(one, _mm_or_ps(_mm_and_ps(valid, det), _mm_andnot_ps(valid, one)));
+
+	__m128 tx = _mm_sub_ps(_mm_set1_ps(ray.O[0]), _mm_loadu_ps(v0[0]));
+	__m128 ty = _mm_sub_ps(_mm_set1_ps(ray.O[1]), _mm_loadu_ps(v0[1]));
+	__m128 tz = _mm_sub_ps(_mm_set1_ps(ray.O[2]), _mm_loadu_ps(v0[2]));
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inv);
+	__m128 minUV = _mm_sub_ps(zero, eps);
+	valid = _mm_and_ps(valid, _mm_cmpge_ps(u, minUV));
+
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+	valid = _mm_and_ps(valid, _mm_cmpge_ps(v, minUV));
+	valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_add_ps(one, eps)));
+
+	__m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+	__m128 dist = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, tx), _mm_andnot_ps(signMask, ty)), _mm_andnot_ps(signMask, tz));
+	valid = _mm_and_ps(valid, _mm_cmpge_ps(tt, _mm_sub_ps(zero, _mm_mul_ps(eps, dist))));
+	valid = _mm_and_ps(valid, _mm_cmplt_ps(tt, _mm_set1_ps(maxTLimit(maxT))));
+
+	_mm_storeu_ps(t, tt);
+	return _mm_movemask_ps(valid);
+}
+
+#else
+
+int TrianglePacket::intersect(const PacketRay &ray, float maxT, float *t) const
+{
+	return intersectScalar(ray, maxT, t);
+}
+
+#endif
+
+int TrianglePacket::intersectScalar(const PacketRay &ray, float maxT, float *t) const
+{
+	const float *D = ray.D;
+	const float eps = TRIANGLE_PACKET_EPSILON, limit = maxTLimit(maxT);
+	int mask = 0;
+
+	for (int lane = 0; lane < TRIANGLE_PACKET_WIDTH; lane++)
+	{
+		t[lane] = 0.0f;
+		float px = D[1]*e2[2][lane] - D[2]*e2[1][lane];
+		float py = D[2]*e2[0][lane] - D[0]*e2[2][lane];
+		float pz = D[0]*e2[1][lane] - D[1]*e2[0][lane];
+		float det = e1[0][lane]*px + e1[1][lane]*py + e1[2][lane]*pz;
+		if (det == 0.0f)
+			continue;
+		float inv = 1.0f/det;
+
+		float tx = ray.O[0] - v0[0][lane], ty = ray.O[1] - v0[1][lane], tz = ray.O[2] - v0[2][lane];
+		float u = (tx*px + ty*py + tz*pz)*inv;
+		if (u < -eps)
+			continue;
+
+		float qx = ty*e1[2][lane] - tz*e1[1][lane];
+		float qy = tz*e1[0][lane] - tx*e1[2][lane];
+		float qz = tx*e1[1][lane] - ty*e1[0][lane];
+		float v = (D[0]*qx + D[1]*qy + D[2]*qz)*inv;
+		if (v < -eps || u + v > 1.0f + eps)
+			continue;
+
+		t[lane] = (e2[0][lane]*qx + e2[1][lane]*qy + e2[2][lane]*qz)*inv;
+		if (t[lane] >= -eps*(fabsf(tx) + fabsf(ty) + fabsf(tz)) && t[lane] < limit)
+			mask |= 1 << lane;
+	}
+
+	return mask;
+}
@@ -0,0 +1,90 @@
+//
+//  Framework for a raytracer
+//  File: trianglepacket.h
+//
+//  Created for the Computer Science course "Introduction Computer Graphics"
+//  taught at the University of Groningen by Tobias Isenberg.
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+//  This framework is inspired by and uses code of the raytracer framework of
+//  Bert Freudenberg that can be found at
+//  http://isgwww.cs.uni-magdeburg.de/graphik/lehre/cg2/projekt/rtprojekt.html
+//
+
+#ifndef TRIANGLEPACKET_H
+#define TRIANGLEPACKET_H
+
+#include "triple.h"
+#include "ray.h"
+
+// Number of triangles tested at once: one per lane of the widest
+// vector unit the compiler was told about (see the Makefile)
+#if defined(__AVX__)
+#define TRIANGLE_PACKET_WIDTH 8
+#else
+#define TRIANGLE_PACKET_WIDTH 4
+#endif
+
+// How far (in barycentric coordinates) outside a triangle a ray may pass
+// and still be reported as a candidate, to make up for single precision
+#define TRIANGLE_PACKET_EPSILON 1e-3f
+
+/**
+ * A ray in single precision, set up once and then tested against
+ * any number of triangle packets.
+ */
+class PacketRay
+{
+public:
+	PacketRay(const Ray &ray)
+	{
+		for (int i = 0; i < 3; i++) {
+			O[i] = (float)ray.O.data[i];
+			D[i] = (float)ray.D.data[i];
+		}
+	}
+
+	float O[3], D[3];
+};
+
+/**
+ * Up to TRIANGLE_PACKET_WIDTH triangles in structure-of-arrays layout,
+ * i.e. v0[0] holds the x coordinates of the first vertex of every
+ * triangle. Each triangle is stored as one vertex and the two edges
+ * leaving it, which is what the Moller-Trumbore test needs.
+ * Unused lanes hold degenerate triangles that are never hit.
+ */
+class TrianglePacket
+{
+public:
+	TrianglePacket() { clear(); }
+
+	void clear();
+	void set(int lane, const Point &p1, const Point &p2, const Point &p3, unsigned int index);
+
+	/**
+	 * Intersect a ray with all triangles in the packet at once.
+	 * The test is conservative: every triangle the ray hits is reported,
+	 * but so are triangles the ray passes within TRIANGLE_PACKET_EPSILON
+	 * of. Callers confirm the candidates with Triangle::intersect(), so
+	 * neighbouring triangles never show cracks between them.
+	 * @param ray Ray to intersect with
+	 * @param maxT Ignore intersections with a t value greater than or equal to this
+	 * @param t Array of TRIANGLE_PACKET_WIDTH elements that receives the
+	 *          (single precision) t value of every candidate lane
+	 * @return Bitmask of the candidate lanes
+	 */
+	int intersect(const PacketRay &ray, float maxT, float *t) const;
+
+	// The same test without vector instructions
+	int intersectScalar(const PacketRay &ray, float maxT, float *t) const;
+
+	float v0[3][TRIANGLE_PACKET_WIDTH], e1[3][TRIANGLE_PACKET_WIDTH], e2[3][TRIANGLE_PACKET_WIDTH];
+	// Index of the triangle in each lane, for the owner's bookkeeping
+	unsigned int index[TRIANGLE_PACKET_WIDTH];
+};
+
+#endif /* end of include guard: TRIANGLEPACKET_H */
@@ -0,0 +1,322 @@
+//
+//  Framework for a raytracer
+//  File: triangletest.cpp
+//
+//  Checks the vectorized ray-triangle test in TrianglePacket against
+//  the reference Triangle::intersect(), PrimitiveStore against the
+//  objects' own intersect(), and CSG of spheres against testing points
+//  inside the spheres. Run with "make test".
+//
+//  Authors:
+//    Roan Kattouw
+//    Jan Paul Posma
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "triangle.h"
+#include "trianglepacket.h"
+#include "quad.h"
+#include "sphere.h"
+#include "cylinder.h"
+#include "primitivestore.h"
+#include "csg.h"
+#include "model.h"
+#include "instance.h"
+using namespace std;
+
+static double random(double min, double max)
+{
+	return min + (max - min)*((double)rand()/(double)RAND_MAX);
+}
+
+static Point randomPoint(double size)
+{
+	return Point(random(-size, size), random(-size, size), random(-size, size));
+}
+
+// Tells whether a ray grazes the triangle's plane: single and double
+// precision may legitimately disagree about those
+static bool grazes(const Point &p1, const Point &p2, const Point &p3, const Ray &ray)
+{
+	return fabs(ray.D.dot(Triangle::normal(p1, p2, p3))) < 1e-3;
+}
+
+static int failures = 0, checked = 0, hits = 0;
+
+static void check(bool ok, const char *what, int test)
+{
+	if (!ok) {
+		failures++;
+		if (failures < 20)
+			printf("FAIL: %s (test %i)\n", what, test);
+	}
+}
+
+// Compare the closest hit of one ray with a packet of triangles
+static void testPacket(int test, bool scalar)
+{
+	Point p[TRIANGLE_PACKET_WIDTH][3];
+	TrianglePacket packet;
+	// Leave some lanes empty now and then
+	int lanes = 1 + rand() % TRIANGLE_PACKET_WIDTH;
+	for (int lane = 0; lane < lanes; lane++) {
+		Point center = randomPoint(200);
+		for (int i = 0; i < 3; i++)
+			p[lane][i] = center + randomPoint(50);
+		packet.set(lane, p[lane][0], p[lane][1], p[lane][2], lane);
+	}
+
+	// Aim the ray at one of the triangles most of the time, and at
+	// one of its edges now and then
+	Point O = randomPoint(500);
+	int target = rand() % lanes;
+	double b = random(0, 1), c = random(0, 1 - b);
+	if (rand() % 4 == 0)
+		c = 1 - b;
+	Point aim = p[target][0] + b*(p[target][1] - p[target][0]) + c*(p[target][2] - p[target][0]);
+	if (rand() % 4 == 0)
+		aim = randomPoint(250);
+	Ray ray(O, aim - O);
+
+	// Reference: closest hit over all triangles, in double precision
+	int refLane = -1;
+	double refT = 0.0;
+	for (int lane = 0; lane < lanes; lane++) {
+		if (grazes(p[lane][0], p[lane][1], p[lane][2], ray))
+			return;
+		double t;
+		if (Triangle::intersect(p[lane][0], p[lane][1], p[lane][2], ray, &t) && (refLane < 0 || t < refT)) {
+			refLane = lane;
+			refT = t;
+		}
+	}
+	float t[TRIANGLE_PACKET_WIDTH];
+	PacketRay pray(ray);
+	int mask = scalar ? packet.intersectScalar(pray, 1e30f, t) : packet.intersect(pray, 1e30f, t);
+
+	// Every triangle that is hit must be a candidate
+	checked++;
+	for (int lane = 0; lane < lanes; lane++) {
+		double tRef;
+		if (Triangle::intersect(p[lane][0], p[lane][1], p[lane][2], ray, &tRef))
+			check(mask & (1 << lane), "triangle that is hit is not a candidate", test);
+	}
+
+	// Confirming the candidates like Model does must give the reference hit
+	int lane = -1;
+	double tHit = 0.0;
+	for (int i = 0; i < lanes; i++) {
+		double tLane;
+		if ((mask & (1 << i)) && Triangle::intersect(p[i][0], p[i][1], p[i][2], ray, &tLane) && (lane < 0 || tLane < tHit)) {
+			lane = i;
+			tHit = tLane;
+		}
+	}
+	check(lane == refLane, "packet and reference disagree about which triangle is hit", test);
+	if (lane < 0 || lane != refLane)
+		return;
+	hits++;
+
+	// The single precision t must be close to the real one
+	check(fabs(t[lane] - refT) <= 1e-3*refT, "t differs", test);
+
+	// The normal must follow from the packed edges as well
+	Vector e1(packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane]);
+	Vector e2(packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane]);
+	Vector N = e1.cross(e2).normalized();
+	Vector refN = Triangle::normal(p[refLane][0], p[refLane][1], p[refLane][2]);
+	check((N - refN).length() < 1e-4, "normal differs", test);
+}
+
+// Compare Quad::intersect with its two reference triangles
+static void testQuad(int test)
+{
+	Point c = randomPoint(200);
+	Vector u = randomPoint(50), v = u.cross(randomPoint(50)).normalized()*random(10, 50);
+	Quad quad(c - u - v, c + u - v, c + u + v, c - u + v, Vector(0, 0, 1), 0.0);
+
+	Point O = randomPoint(500);
+	// Hit the diagonal the two triangles share now and then
+	double a = random(-1.2, 1.2);
+	Ray ray(O, c + a*u + (rand() % 4 ? random(-1.2, 1.2) : a)*v - O);
+	static const double inf = std::numeric_limits<double>::infinity();
+	Hit h1 = quad.t1->intersect(ray, true, inf);
+	Hit h2 = quad.t2->intersect(ray, true, inf);
+	Hit ref = h1.t < h2.t ? h1 : h2;
+	Hit hit = quad.intersect(ray, true, inf);
+
+	checked++;
+	check(hit.hasHit() == ref.hasHit(), "quad and reference disagree about hitting", test);
+	if (!hit.hasHit() || !ref.hasHit())
+		return;
+	hits++;
+	check(hit.t == ref.t, "quad t differs", test);
+	check((hit.N - ref.N).length() == 0.0, "quad normal differs", test);
+}
+
+// Compare PrimitiveStore with intersecting its objects one by one
+static void testStore(int test)
+{
+	std::vector<Object*> objects;
+	PrimitiveStore store;
+	for (int i = 0; i < 8; i++) {
+		Point c = randomPoint(200);
+		Vector rot(0, 0, 1);
+		switch (rand() % 4) {
+			case 0:
+				objects.push_back(new Sphere(c, random(5, 50)));
+				break;
+			case 1:
+				objects.push_back(new Triangle(c + randomPoint(50), c + randomPoint(50), c + randomPoint(50)));
+				break;
+			case 2:
+			{
+				Vector u = randomPoint(50), v = u.cross(randomPoint(50)).normalized()*random(10, 50);
+				objects.push_back(new Quad(c - u - v, c + u - v, c + u + v, c - u + v, rot, 0.0));
+				break;
+			}
+			default:
+				objects.push_back(new Cylinder(c, c + randomPoint(50), random(5, 30), rot, 0.0));
+				break;
+		}
+		store.add(objects.back());
+	}
+
+	// Aim close to one of the objects, so most rays hit something
+	Point O = randomPoint(500);
+	Ray ray(O, objects[rand() % objects.size()]->getRotationCenter() + randomPoint(30) - O);
+	Hit ref = Hit::NO_HIT();
+	for (unsigned int i = 0; i < objects.size(); i++) {
+		Hit hit = objects[i]->intersect(ray, true, std::numeric_limits<double>::infinity());
+		if (hit.hasHit() && (hit.t < ref.t || !ref.hasHit()))
+			ref = hit;
+	}
+	Hit hit = store.intersect(0, store.size(), ray, true, std::numeric_limits<double>::infinity(), NULL);
+
+	checked++;
+	check(hit.hasHit() == ref.hasHit(), "store and objects disagree about hitting", test);
+	if (hit.hasHit() && ref.hasHit()) {
+		hits++;
+		check(hit.t == ref.t && hit.obj == ref.obj, "store hit differs", test);
+		check((hit.N - ref.N).length() == 0.0 && hit.entering == ref.entering, "store normal differs", test);
+	}
+
+	for (unsigned int i = 0; i < objects.size(); i++)
+		delete objects[i];
+}
+
+static bool insideSphere(const Sphere &s, const Point &p)
+{
+	return (p - s.position).length_2() < s.r*s.r;
+}
+
+static bool insideCsg(const Sphere &s1, const Sphere &s2, Csg::Operation op, const Point &p)
+{
+	bool in1 = insideSphere(s1, p), in2 = insideSphere(s2, p);
+	return op == Csg::opUnion ? in1 || in2 : (op == Csg::opIntersect ? in1 && in2 : in1 && !in2);
+}
+
+// Check that a CSG of two spheres is hit where the ray goes in or out of it
+static void testCsg(int test)
+{
+	Sphere *s1 = new Sphere(randomPoint(50), random(20, 60));
+	Sphere *s2 = new Sphere(s1->position + randomPoint(50), random(20, 60));
+	Csg::Operation op = (Csg::Operation)(rand() % 3);
+	Csg csg(s1, s2, Point(0, 0, 0), op);
+
+	// Start inside now and then
+	Point O = rand() % 4 ? randomPoint(300) : s1->position + randomPoint(20);
+	Ray ray(O, s1->position + randomPoint(60) - O);
+	Hit hit = csg.intersect(ray, true, std::numeric_limits<double>::infinity());
+
+	checked++;
+	static const double eps = 1e-6;
+	if (hit.hasHit()) {
+		hits++;
+		bool before = insideCsg(*s1, *s2, op, ray.at(hit.t - eps));
+		bool after = insideCsg(*s1, *s2, op, ray.at(hit.t + eps));
+		check(hit.t >= 0 && before != after && after == hit.entering, "csg hit is not on the boundary", test);
+		check(hit.N.dot(ray.D) <= 0, "csg normal doesn't face the ray", test);
+	} else {
+		// Nothing changes along the ray then
+		bool start = insideCsg(*s1, *s2, op, ray.O);
+		for (int i = 1; i <= 100; i++)
+			if (insideCsg(*s1, *s2, op, ray.at(i*4.0)) != start) {
+				check(false, "csg missed", test);
+				break;
+			}
+	}
+
+	delete s1;
+	delete s2;
+}
+
+// Check that a ray through a closed mesh hits it
+static void testClosed(Object *obj, const Ray &ray, int test)
+{
+	checked++;
+	Hit hit = obj->intersect(ray, true, std::numeric_limits<double>::infinity());
+	check(hit.hasHit(), "ray slips between the triangles of a rotated mesh", test);
+	if (hit.hasHit())
+		hits++;
+}
+
+// Rotated meshes are intersected in their own space, where rays along
+// the world axes can lie exactly in the plane of an edge. Shoot a grid
+// of such rays through a sphere mesh, as a model and in an instance,
+// rotated by multiples of 45 degrees around every axis.
+static void testRotatedMesh()
+{
+	const char *filename = "scenes/obj/sphere.obj";
+	const Point center(200, 200, 0);
+	const double size = 150;
+	int test = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		Vector rot(0, 0, 0);
+		rot.data[axis] = 1;
+		for (int angle = 0; angle < 360; angle += 45) {
+			Model model(center, filename, size, rot, angle);
+			char name[64];
+			sprintf(name, "triangletest-%i-%i", axis, angle);
+			Instance instance(center, name, rot, angle, 1.0);
+			instance.addObject(new Model(Point(0, 0, 0), filename, size));
+			instance.build();
+
+			for (int dir = 0; dir < 3; dir++) {
+				Vector D(0, 0, 0), u(0, 0, 0), v(0, 0, 0);
+				D.data[dir] = 1;
+				u.data[(dir + 1) % 3] = 1;
+				v.data[(dir + 2) % 3] = 1;
+				// Well inside the sphere, so every ray must hit
+				for (int i = -70; i <= 70; i += 5) {
+					for (int j = -70; j <= 70; j += 5) {
+						Point O = center + i*u + j*v - 1000*D;
+						testClosed(&model, Ray(O, D), test);
+						testClosed(&instance, Ray(O, D), test);
+						test++;
+					}
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	srand(1);
+	for (int i = 0; i < 100000; i++)
+		testPacket(i, false);
+	for (int i = 0; i < 20000; i++)
+		testPacket(i, true);
+	for (int i = 0; i < 20000; i++)
+		testQuad(i);
+	for (int i = 0; i < 20000; i++)
+		testStore(i);
+	for (int i = 0; i < 20000; i++)
+		testCsg(i);
+	testRotatedMesh();
+
+	printf("%i packet width, %i rays checked, %i hits, %i failures\n", TRIANGLE_PACKET_WIDTH, checked, hits, failures);
+	return failures ? 1 : 0;
+}
@@ -22,70 +22,84 @@
 #include <iostream>
 using namespace std;
 
-class Triple {
+// Scalar type used for colors, i.e. for all images, textures and
+// framebuffers. Geometry always uses double.
+#ifndef COLOR_SCALAR
+#define COLOR_SCALAR float
+#endif
+
+template <class T>
+class TripleT {
 public:
-	explicit Triple(double X = 0, double Y = 0, double Z = 0)
+	explicit TripleT(T X = 0, T Y = 0, T Z = 0)
 		: x(X), y(Y), z(Z)
 	{
 	}
 
-	Triple operator+(const Triple &t) const
+	// Convert between precisions, e.g. to turn a Vector into a Color
+	template <class U>
+	explicit TripleT(const TripleT<U> &t)
+		: x((T)t.x), y((T)t.y), z((T)t.z)
 	{
-		return Triple(x+t.x, y+t.y, z+t.z);
 	}
 
-	Triple operator+(double f) const
+	TripleT operator+(const TripleT &t) const
 	{
-		return Triple(x+f, y+f, z+f);
+		return TripleT(x+t.x, y+t.y, z+t.z);
 	}
 
-	friend Triple operator+(double f, const Triple &t)
+	TripleT operator+(T f) const
 	{
-		return Triple(f+t.x, f+t.y, f+t.z);
+		return TripleT(x+f, y+f, z+f);
 	}
 
-	Triple operator-() const
+	friend TripleT operator+(T f, const TripleT &t)
 	{
-		return Triple( -x, -y, -z);
+		return TripleT(f+t.x, f+t.y, f+t.z);
 	}
 
-	Triple operator-(const Triple &t) const
+	TripleT operator-() const
 	{
-		return Triple(x-t.x, y-t.y, z-t.z);
+		return TripleT( -x, -y, -z);
 	}
 
-	Triple operator-(double f) const
+	TripleT operator-(const TripleT &t) const
 	{
-		return Triple(x-f, y-f, z-f);
+		return TripleT(x-t.x, y-t.y, z-t.z);
 	}
 
-	friend Triple operator-(double f, const Triple &t)
+	TripleT operator-(T f) const
 	{
-		return Triple(f-t.x, f-t.y, f-t.z);
+		return TripleT(x-f, y-f, z-f);
 	}
 
-	Triple operator*(const Triple &t) const
+	friend TripleT operator-(T f, const TripleT &t)
 	{
-		return Triple(x*t.x,y*t.y,z*t.z);
+		return TripleT(f-t.x, f-t.y, f-t.z);
 	}
 
-	Triple operator*(double f) const
+	TripleT operator*(const TripleT &t) const
 	{
-		return Triple(x*f, y*f, z*f);
+		return TripleT(x*t.x,y*t.y,z*t.z);
 	}
 
-	friend Triple operator*(double f, const Triple &t)
+	TripleT operator*(T f) const
 	{
-		return Triple(f*t.x, f*t.y, f*t.z);
+		return TripleT(x*f, y*f, z*f);
 	}
 
-	Triple operator/(double f) const
+	friend TripleT operator*(T f, const TripleT &t)
 	{
-		double invf = 1.0/f;
-		return Triple(x*invf, y*invf, z*invf);
+		return TripleT(f*t.x, f*t.y, f*t.z);
 	}
 
-	Triple& operator+=(const Triple &t)
+	TripleT operator/(T f) const
+	{
+		T invf = 1/f;
+		return TripleT(x*invf, y*invf, z*invf);
+	}
+
+	TripleT& operator+=(const TripleT &t)
 	{
 		x += t.x;
 		y += t.y;
@@ -93,7 +107,7 @@ public:
 		return *this;
 	}
 
-	Triple& operator+=(double f)
+	TripleT& operator+=(T f)
 	{
 		x += f;
 		y += f;
@@ -101,7 +115,7 @@ public:
 		return *this;
 	}
 
-	Triple& operator-=(const Triple &t)
+	TripleT& operator-=(const TripleT &t)
 	{
 		x -= t.x;
 		y -= t.y;
@@ -109,7 +123,7 @@ public:
 		return *this;
 	}
 
-	Triple& operator-=(double f)
+	TripleT& operator-=(T f)
 	{
 		x -= f;
 		y -= f;
@@ -117,7 +131,7 @@ public:
 		return *this;
 	}
 
-	Triple& operator*=(const double f)
+	TripleT& operator*=(const T f)
 	{
 		x *= f;
 		y *= f;
@@ -125,9 +139,9 @@ public:
 		return *this;
 	}
 
-	Triple& operator/=(const double f)
+	TripleT& operator/=(const T f)
 	{
-		double invf = 1.0/f;
+		T invf = 1/f;
 		x *= invf;
 		y *= invf;
 		z *= invf;
@@ -135,32 +149,32 @@ public:
 	}
 
 
-	double dot(const Triple &t) const
+	T dot(const TripleT &t) const
 	{
 		return x*t.x + y*t.y + z*t.z;
 	}
 
-	Triple cross(const Triple &t) const
+	TripleT cross(const TripleT &t) const
 	{
-		return Triple( y*t.z - z*t.y,
+		return TripleT( y*t.z - z*t.y,
 			z*t.x - x*t.z,
 			x*t.y - y*t.x);
 	}
 
-	double length() const
+	T length() const
 	{
 		return sqrt(length_2());
 	}
 
-	double length_2() const
+	T length_2() const
 	{
 		return x*x + y*y + z*z;
 	}
 
-	Triple normalized() const
+	TripleT normalized() const
 	{
-		double l = length();
-		if ( l == 0.0 )
+		T l = length();
+		if ( l == 0 )
 			return *this;
 		else
 			return (*this) / length();
@@ -168,42 +182,39 @@ public:
 
 	void normalize()
 	{
-		double l = length();
-		if ( l == 0.0 )
+		T l = length();
+		if ( l == 0 )
 			return;
-		double invl = 1/l;
+		T invl = 1/l;
 		x *= invl;
 		y *= invl;
 		z *= invl;
 	}	
 
-	friend istream& operator>>(istream &s, Triple &v);
-	friend ostream& operator<<(ostream &s, const Triple &v);
-
 	// Functions for when used as a Color:
-	void set(double f)
+	void set(T f)
 	{
 		r = g = b = f;
 	}
 
-	void set(double f, double maxValue)
+	void set(T f, T maxValue)
 	{
 		set(f/maxValue);
 	}
 
-	void set(double red, double green, double blue)
+	void set(T red, T green, T blue)
 	{
 		r = red;
 		g = green;
 		b = blue;
 	}
 
-	void set(double r, double g, double b, double maxValue)
+	void set(T r, T g, T b, T maxValue)
 	{
 		set(r/maxValue,g/maxValue,b/maxValue);
 	}
 
-	void clamp(double maxValue = 1.0)
+	void clamp(T maxValue = 1.0)
 	{
 		if (r > maxValue) r = maxValue;
 		if (g > maxValue) g = maxValue;
@@ -211,21 +222,28 @@ public:
 	}
 
 	union {
-		double data[3];
+		T data[3];
 		struct {
-			double x;
-			double y;
-			double z;
+			T x;
+			T y;
+			T z;
 		};
 		struct {
-			double r;
-			double g;
-			double b;
+			T r;
+			T g;
+			T b;
 		};
 	};
 };
 
-typedef Triple Color;
+template <class T>
+ostream& operator<<(ostream &s, const TripleT<T> &v)
+{
+	return s << '[' << v.x << ',' << v.y << ',' << v.z << ']';
+}
+
+typedef TripleT<double> Triple;
+typedef TripleT<COLOR_SCALAR> Color;
 typedef Triple Point;
 typedef Triple Vector;
 